@@ -0,0 +1,120 @@
+//===- KaleidoscopeJIT.h - A simple JIT for Kaleidoscope --------*- C++ -*-===//
+//
+// Contains a simple JIT definition for use in the kaleidoscope tutorials.
+// (LLVM 14 ORC version, kept next to my-lang.cc since the system LLVM does
+// not install the tutorial headers.)
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
+#define LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
+#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/LLVMContext.h"
+#include <memory>
+
+namespace llvm {
+namespace orc {
+
+class KaleidoscopeJIT {
+private:
+    std::unique_ptr<ExecutionSession> ES;
+
+    DataLayout DL;
+    MangleAndInterner Mangle;
+
+    RTDyldObjectLinkingLayer ObjectLayer;
+    IRCompileLayer CompileLayer;
+
+    JITDylib &MainJD;
+
+public:
+    KaleidoscopeJIT(std::unique_ptr<ExecutionSession> ES,
+                    JITTargetMachineBuilder JTMB, DataLayout DL)
+        : ES(std::move(ES)), DL(std::move(DL)), Mangle(*this->ES, this->DL),
+          ObjectLayer(*this->ES,
+                      []() { return std::make_unique<SectionMemoryManager>(); }),
+          CompileLayer(*this->ES, ObjectLayer,
+                       std::make_unique<ConcurrentIRCompiler>(std::move(JTMB))),
+          MainJD(this->ES->createBareJITDylib("<main>")) {
+        MainJD.addGenerator(
+            cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                this->DL.getGlobalPrefix())));
+    }
+
+    ~KaleidoscopeJIT() {
+        if (auto Err = ES->endSession())
+            ES->reportError(std::move(Err));
+    }
+
+    static Expected<std::unique_ptr<KaleidoscopeJIT>> Create() {
+        auto EPC = SelfExecutorProcessControl::Create();
+        if (!EPC)
+            return EPC.takeError();
+
+        auto ES = std::make_unique<ExecutionSession>(std::move(*EPC));
+
+        // Target the host CPU (not just its triple) so JIT'd code may use
+        // every vector extension the machine has.
+        auto JTMB = JITTargetMachineBuilder::detectHost();
+        if (!JTMB)
+            return JTMB.takeError();
+
+        auto DL = JTMB->getDefaultDataLayoutForTarget();
+        if (!DL)
+            return DL.takeError();
+
+        return std::make_unique<KaleidoscopeJIT>(std::move(ES), std::move(*JTMB),
+                                                 std::move(*DL));
+    }
+
+    const DataLayout &getDataLayout() const { return DL; }
+
+    JITDylib &getMainJITDylib() { return MainJD; }
+
+    /// createSessionDylib - A fresh JITDylib that falls back to <main>, and so
+    /// to the host process, for symbols it does not define itself.
+    Expected<JITDylib &> createSessionDylib(const std::string &Name) {
+        auto JD = ES->createJITDylib(Name);
+        if (!JD)
+            return JD.takeError();
+        JD->addToLinkOrder(MainJD);
+        return JD;
+    }
+
+    /// removeDylib - Drop JD along with all code and memory it owns.
+    Error removeDylib(JITDylib &JD) { return ES->removeJITDylib(JD); }
+
+    /// releaseDeadSymbols - Drop interned symbol names that nothing refers to
+    /// any more, e.g. those of code removed through a ResourceTracker.
+    void releaseDeadSymbols() { ES->getSymbolStringPool()->clearDeadEntries(); }
+
+    Error addModule(ThreadSafeModule TSM, ResourceTrackerSP RT = nullptr) {
+        if (!RT)
+            RT = MainJD.getDefaultResourceTracker();
+        return CompileLayer.add(RT, std::move(TSM));
+    }
+
+    Expected<JITEvaluatedSymbol> lookup(StringRef Name) {
+        return ES->lookup({&MainJD}, Mangle(Name.str()));
+    }
+
+    Expected<JITEvaluatedSymbol> lookup(JITDylib &JD, StringRef Name) {
+        return ES->lookup({&JD}, Mangle(Name.str()));
+    }
+};
+
+} // end namespace orc
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
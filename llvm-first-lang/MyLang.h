@@ -0,0 +1,138 @@
+//===- MyLang.h - Embedding interface for my-lang ---------------*- C++ -*-===//
+//
+// Sessions and batch calls for host programs that embed the compiler instead
+// of running the my-lang driver. Link against the mylang library target and
+// set up LLVM the way main() does:
+//
+//   InitializeNativeTarget();
+//   InitializeNativeTargetAsmPrinter();
+//   InitializeNativeTargetAsmParser();
+//   auto JIT = ExitOnErr(KaleidoscopeJIT::Create());
+//
+//   std::istringstream Src("def scale(x y) x * 2.5 + y;");
+//   SessionOptions Opts;
+//   Opts.Interactive = false;
+//   SessionPtr S = createSession(Src, *JIT, Opts);
+//   RunSession(*S);
+//   BatchCallFn Fn = compileBatchCall(*S, "scale");
+//   runBatchCall(Fn, Args, Out, N, Threads);
+//
+// The library registers no command-line options; the driver's flags map onto
+// SessionOptions. Defs that call the "library" functions (putchard, printd,
+// ...) need them exported from the host executable (-rdynamic), as the
+// driver does.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MYLANG_H
+#define MYLANG_H
+
+#include "KaleidoscopeJIT.h"
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 값의 타입. 주석이 없으면 double (예전 동작 그대로).
+//   def f(x:int y:double):int ...
+// type_unknown 은 추론 중에만 쓰인다 (아직 모르는 재귀 호출 결과 등).
+enum VarType {
+    type_unknown,
+    type_double,
+    type_int,  // i64
+    type_bool, // i1
+};
+
+/// BatchCallFn - A JIT'd loop applying one def to columns of arguments:
+/// Out[I] = F(Args[0][I], Args[1][I], ...) for I in [Begin, End). Each column
+/// and Out hold the def's own argument/return types (double, int64_t or
+/// bool); Out must not overlap the inputs. See compileBatchCall().
+typedef void (*BatchCallFn)(void *const *Args, void *Out, int64_t Begin,
+                            int64_t End);
+
+/// Session - One independent compilation with a JITDylib of its own; see
+/// createSession(). Opaque to hosts.
+struct Session;
+
+/// ProfileData - Counts read by readProfile(), for SessionOptions::ProfileUse.
+struct ProfileData;
+
+/// SessionOptions - What the driver's flags (named in brackets) set.
+struct SessionOptions {
+    /// Prompts, IR dumps and results go to stderr.
+    bool Interactive = true;
+    /// Batch every def into one module and run the interprocedural pipeline
+    /// at end of input [-ipo].
+    bool IPO = false;
+    /// Write that module to an object file instead of running it; implies
+    /// IPO [-o].
+    std::string OutputFilename;
+    /// Count entries and branches of every def; see writeProfile()
+    /// [-profile-generate].
+    bool ProfileGenerate = false;
+    /// Attach entry counts and branch weights from a profile
+    /// [-profile-use].
+    std::shared_ptr<const ProfileData> ProfileUse;
+    /// Report self calls left after tail-call elimination
+    /// [-report-tail-calls].
+    bool ReportTailCalls = false;
+    /// Cache the results of pure recursive defs [-memoize], in tables of
+    /// MemoizeSlots entries rounded up to a power of two, at most
+    /// MaxMemoizeSlots [-memoize-slots].
+    bool Memoize = false;
+    unsigned MemoizeSlots = 4096;
+    /// Print time per compile phase when the session ends [-time-phases].
+    bool TimePhases = false;
+};
+
+/// MaxMemoizeSlots - Bound on SessionOptions::MemoizeSlots. Each table is a
+/// zeroed global in the JIT'd image, so this already allows hundreds of MB
+/// per def.
+const uint64_t MaxMemoizeSlots = 1 << 24;
+
+struct SessionDeleter {
+    void operator()(Session *S) const;
+};
+typedef std::unique_ptr<Session, SessionDeleter> SessionPtr;
+
+/// createSession - A session reading its program from In. Sessions share
+/// only JIT's ExecutionSession, so each one can compile and run on its own
+/// thread. Null if Opts.MemoizeSlots is out of range.
+SessionPtr createSession(std::istream &In, llvm::orc::KaleidoscopeJIT &JIT,
+                         const SessionOptions &Opts = SessionOptions());
+
+/// RunSession - Compile and run everything S reads until end of input.
+void RunSession(Session &S);
+
+/// readProfile - Load a profile written by writeProfile(). Null (after
+/// printing why) if Filename can't be read.
+std::shared_ptr<const ProfileData> readProfile(const std::string &Filename);
+
+/// writeProfile - Save the counts of a ProfileGenerate session.
+bool writeProfile(Session &S, const std::string &Filename);
+
+/// getDefSignature - Argument and return types of def Name, e.g. to lay out
+/// the columns for compileBatchCall(). False if S has no such def.
+bool getDefSignature(Session &S, const std::string &Name,
+                     std::vector<VarType> &ArgTypes, VarType &RetType);
+
+/// lookupDef - Address of def Name's JIT'd code, or 0 if there is none
+/// (e.g. under IPO, which internalizes defs). Cast it to the def's own
+/// signature before calling.
+uint64_t lookupDef(Session &S, const std::string &Name);
+
+/// compileBatchCall - JIT a BatchCallFn for def Name. Its body and callees
+/// are re-emitted privately and inlined into the loop, so the loop can be
+/// vectorized. The wrapper keeps no state and lives as long as S; call it
+/// from any number of threads on disjoint ranges. Use it between top-level
+/// items or after RunSession(), not halfway through an IPO batch. Null if
+/// S has no def Name.
+BatchCallFn compileBatchCall(Session &S, const std::string &Name);
+
+/// runBatchCall - Run Fn over [0, N) on Threads threads, one contiguous chunk
+/// each.
+void runBatchCall(BatchCallFn Fn, void *const *Args, void *Out, int64_t N,
+                  unsigned Threads);
+
+#endif // MYLANG_H
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+"""Compile-latency and runtime benchmark for my-lang.
+
+Generates synthetic programs, runs the compiler on each one with -time-phases
+and writes one JSON object per run (JSON lines), e.g.
+
+  {"commit": "c63ff7e", "workload": "many_defs", "mode": "jit", "run": 0,
+   "parse_s": ..., "codegen_s": ..., "optimize_s": ..., "jit_link_s": ...,
+   "exec_s": ..., "wall_s": ..., "defs": 2000, "exprs": 20}
+
+Usage:
+  bench.py --compiler build/my-lang [--runs 5] [--scale 1.0] [-o out.jsonl]
+  bench.py --emit DIR                  write the generated programs and exit
+  bench.py --compare old.jsonl new.jsonl
+                                       median of each phase, side by side
+
+The workloads are:
+  many_defs   lots of small defs calling each other: per-def overhead
+  deep_expr   defs whose bodies are deeply nested expressions: parser and
+              codegen recursion, instcombine/reassociate on big expressions
+  recursive   fib, binom, collatz and a tail-recursive loop: execution time
+"""
+
+import argparse
+import json
+import os
+import random
+import statistics
+import subprocess
+import sys
+import time
+
+PHASES = ["parse_s", "codegen_s", "optimize_s", "jit_link_s", "exec_s",
+          "wall_s"]
+
+MODES = {
+    "jit": [],
+    "ipo": ["-ipo"],
+    "memoize": ["-memoize"],
+}
+
+
+# --------------------------------------------------------------------------
+# Program generators
+# --------------------------------------------------------------------------
+
+def gen_many_defs(scale):
+    n = max(2, int(2000 * scale))
+    out = ["def f0(x y) x + y;"]
+    for i in range(1, n):
+        if i % 2:
+            out.append("def f%d(x y) f%d(y, x) * 0.5 + x - %d.0;" % (i, i - 1, i))
+        else:
+            out.append("def f%d(x y) if x < y then f%d(x, y) + 1.0 "
+                       "else f%d(y, x) - 1.0;" % (i, i - 1, i - 1))
+    step = max(1, n // 20)
+    for i in range(step - 1, n, step):
+        out.append("f%d(1.5, 2.5);" % i)
+    return "\n".join(out) + "\n"
+
+
+def gen_leaf(rng, names):
+    if rng.random() < 0.5:
+        return rng.choice(names)
+    return "%d.%d" % (rng.randint(0, 9), rng.randint(0, 9))
+
+
+def gen_small_expr(rng, depth, names):
+    if depth == 0:
+        return gen_leaf(rng, names)
+    return "(%s %s %s)" % (gen_small_expr(rng, depth - 1, names),
+                           rng.choice("+-*"),
+                           gen_small_expr(rng, depth - 1, names))
+
+
+def gen_expr(rng, depth, names):
+    """A spine of `depth` nested parentheses with small subtrees hanging off
+    it. Built inside out so Python's recursion limit doesn't apply."""
+    expr = gen_leaf(rng, names)
+    for _ in range(depth):
+        side = gen_small_expr(rng, rng.randint(0, 2), names)
+        op = rng.choice("+-*")
+        if rng.random() < 0.5:
+            expr = "(%s %s %s)" % (expr, op, side)
+        else:
+            expr = "(%s %s %s)" % (side, op, expr)
+    return expr
+
+
+def gen_deep_expr(scale):
+    rng = random.Random(34)
+    n = max(1, int(40 * scale))
+    out = []
+    for i in range(n):
+        out.append("def g%d(x y) %s;" % (i, gen_expr(rng, 400, ["x", "y"])))
+    for i in range(n):
+        out.append("g%d(0.5, 0.25);" % i)
+    return "\n".join(out) + "\n"
+
+
+def gen_recursive(scale):
+    def s(v):
+        return max(1, int(v * scale))
+    return """\
+def fib(n:int) : int if n < 2 then n else fib(n-1) + fib(n-2);
+def fibd(x) if x < 2.0 then x else fibd(x-1.0) + fibd(x-2.0);
+def binom(n:int k:int) : int
+    if k < 1 then 1 else if n < k + 1 then 1
+    else binom(n-1, k-1) + binom(n-1, k);
+def collatz(n:int steps:int) : int
+    if n < 2 then steps
+    else if n %% 2 < 1 then collatz(n / 2, steps + 1)
+    else collatz(3 * n + 1, steps + 1);
+def csum(i:int acc:int) : int
+    if i < 1 then acc else csum(i - 1, acc + collatz(i, 0));
+def loop(i:int acc:int) : int if i < 1 then acc else loop(i - 1, acc + i);
+fib(%d);
+fibd(%d);
+binom(%d, %d);
+csum(%d, 0);
+loop(%d, 0);
+""" % (min(s(30), 40), min(s(27), 35), min(s(24), 32), min(s(24), 32) // 2,
+       s(200000), s(50000000))
+
+
+WORKLOADS = {
+    "many_defs": gen_many_defs,
+    "deep_expr": gen_deep_expr,
+    "recursive": gen_recursive,
+}
+
+
+# --------------------------------------------------------------------------
+# Running
+# --------------------------------------------------------------------------
+
+def current_commit():
+    here = os.path.dirname(os.path.abspath(__file__))
+    try:
+        rev = subprocess.run(["git", "rev-parse", "--short", "HEAD"], cwd=here,
+                             capture_output=True, text=True, check=True)
+        dirty = subprocess.run(["git", "status", "--porcelain", "--", ".."],
+                               cwd=here, capture_output=True, text=True)
+        return rev.stdout.strip() + ("-dirty" if dirty.stdout.strip() else "")
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def run_once(compiler, flags, source):
+    start = time.perf_counter()
+    proc = subprocess.run([compiler, "-time-phases"] + flags, input=source,
+                          capture_output=True, text=True)
+    wall = time.perf_counter() - start
+    if proc.returncode != 0 or "LogError" in proc.stderr:
+        raise RuntimeError("my-lang failed (exit %d):\n%s" %
+                           (proc.returncode, proc.stderr[-2000:]))
+
+    for line in proc.stdout.splitlines():
+        if line.startswith("phases "):
+            result = {}
+            for field in line.split()[1:]:
+                key, value = field.split("=")
+                result[key] = float(value) if key.endswith("_s") else int(value)
+            result["wall_s"] = wall
+            return result
+    raise RuntimeError("no phases line in my-lang output")
+
+
+def run(args):
+    commit = current_commit()
+    out = open(args.output, "w") if args.output else sys.stdout
+    for name in args.workloads.split(","):
+        source = WORKLOADS[name](args.scale)
+        for mode in args.modes.split(","):
+            for i in range(args.runs):
+                result = run_once(args.compiler, MODES[mode], source)
+                record = {"commit": commit, "workload": name, "mode": mode,
+                          "run": i}
+                record.update(result)
+                out.write(json.dumps(record) + "\n")
+                out.flush()
+                print("%-10s %-8s run %d: wall %.3fs" %
+                      (name, mode, i, result["wall_s"]), file=sys.stderr)
+    if out is not sys.stdout:
+        out.close()
+
+
+def emit(args):
+    os.makedirs(args.emit, exist_ok=True)
+    for name, gen in WORKLOADS.items():
+        path = os.path.join(args.emit, name + ".k")
+        with open(path, "w") as f:
+            f.write(gen(args.scale))
+        print(path)
+
+
+def medians(path):
+    runs = {}
+    with open(path) as f:
+        for line in f:
+            r = json.loads(line)
+            runs.setdefault((r["workload"], r["mode"]), []).append(r)
+    return {key: {p: statistics.median(r[p] for r in rs) for p in PHASES}
+            for key, rs in runs.items()}
+
+
+def compare(args):
+    old, new = medians(args.compare[0]), medians(args.compare[1])
+    print("%-10s %-8s %-11s %10s %10s %7s" %
+          ("workload", "mode", "phase", "old", "new", "new/old"))
+    for key in sorted(set(old) & set(new)):
+        for p in PHASES:
+            a, b = old[key][p], new[key][p]
+            ratio = "%7.2f" % (b / a) if a > 0 else "      -"
+            print("%-10s %-8s %-11s %10.4f %10.4f %s" %
+                  (key[0], key[1], p, a, b, ratio))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("--compiler", help="path to the my-lang binary")
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--scale", type=float, default=1.0,
+                        help="multiply program sizes and inputs")
+    parser.add_argument("--workloads", default=",".join(WORKLOADS))
+    parser.add_argument("--modes", default="jit,ipo",
+                        help="comma-separated, from: " + ", ".join(MODES))
+    parser.add_argument("-o", "--output", help="JSON lines file "
+                        "(default: stdout)")
+    parser.add_argument("--emit", metavar="DIR")
+    parser.add_argument("--compare", nargs=2, metavar=("OLD", "NEW"))
+    args = parser.parse_args()
+
+    if args.emit:
+        emit(args)
+    elif args.compare:
+        compare(args)
+    elif args.compiler:
+        run(args)
+    else:
+        parser.error("one of --compiler, --emit or --compare is required")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,21 +1,63 @@
+#include "KaleidoscopeJIT.h"
+#include "MyLang.h"
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/StandardInstrumentations.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO/FunctionAttrs.h"
+#include "llvm/Transforms/IPO/GlobalDCE.h"
+#include "llvm/Transforms/IPO/Inliner.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+#include "llvm/Transforms/IPO/SCCP.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Scalar/Reassociate.h"
+#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/Scalar/TailRecursionElimination.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 #include <memory>
 #include <map>
 
-using namespace std;
+using namespace llvm;
+using namespace llvm::orc;
+
+// VarType, BatchCallFn and SessionOptions are declared in MyLang.h.
 
 // "unknown tokens" are represented by there ASCII code
 enum Token {
@@ -24,60 +66,234 @@ enum Token {
     tok_extern = -3,
     tok_identifier = -4,
     tok_number = -5,
+
+    // control
+    tok_if = -6,
+    tok_then = -7,
+    tok_else = -8,
+};
+
+static bool isIntegral(VarType T) {
+    return T == type_int || T == type_bool;
+}
+
+/// unifyTypes - The type both sides are promoted to when they meet in an
+/// arithmetic operator or in the two arms of an 'if'.
+static VarType unifyTypes(VarType A, VarType B) {
+    if (A == type_unknown) return B;
+    if (B == type_unknown) return A;
+    if (A == B) return A;
+    if (A == type_double || B == type_double) return type_double;
+    return type_int; // int <-> bool
+}
+
+static bool isComparisonOp(char Op) {
+    return Op == '<' || Op == '>';
+}
+
+static bool isBitwiseOp(char Op) {
+    return Op == '&' || Op == '|';
+}
+
+/// binaryResultType - Result type of "L Op R", shared by inference and
+/// codegen so the two never disagree.
+static VarType binaryResultType(char Op, VarType L, VarType R) {
+    if (isComparisonOp(Op))
+        return type_bool;
+    if (isBitwiseOp(Op) && L == type_bool && R == type_bool)
+        return type_bool;
+    VarType T = unifyTypes(L, R);
+    return T == type_bool ? type_int : T;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Compiler session
+//===----------------------------------------------------------------------===//
+
+// The AST lives in an anonymous namespace so the mylang library doesn't
+// export ExprAST & co. into host programs.
+namespace {
+class PrototypeAST;
+class FunctionAST;
+} // end anonymous namespace
+
+/// CompilePhase - Where -time-phases charges wall time.
+enum CompilePhase {
+    phase_none,
+    phase_parse,    // lexing and parsing
+    phase_codegen,  // AST -> IR
+    phase_optimize, // function passes, and the module pipeline with -ipo
+    phase_jit_link, // machine code emission and linking (ORC compiles on
+                    // lookup), code removal, object file emission with -o
+    phase_exec,     // running top-level expressions
+    num_phases
+};
+
+/// FunctionCounters - Live counters of an instrumented function. A deque so
+/// the addresses baked into JIT'd code stay valid as slots are appended.
+typedef std::deque<uint64_t> FunctionCounters;
+
+/// Session - One independent compilation: lexer/parser position, the module
+/// being built with its own context and pass managers, every prototype seen
+/// so far and a JITDylib of its own. Sessions share only the JIT's
+/// ExecutionSession, so each one can lex, parse, compile and run on its own
+/// thread.
+struct Session {
+    Session(std::istream &In, KaleidoscopeJIT &JIT,
+            const SessionOptions &Opts);
+    ~Session();
+
+    SessionOptions Opts;
+
+    // Lexer / parser
+    std::istream &In;
+    int LastChar = ' ';
+    std::string IdentifierStr;
+    double NumVal = 0;
+    int64_t IntVal = 0;
+    bool NumIsInt = false; // literal had no '.', so it is typed as int
+    bool NumOutOfRange = false; // int literal doesn't fit in an i64
+    int CurTok = 0;
+    unsigned AnonExprCount = 0;
+
+    // Code generation
+    std::unique_ptr<LLVMContext> TheContext;
+    std::unique_ptr<IRBuilder<>> Builder;
+    std::unique_ptr<Module> TheModule;
+    std::map<std::string, Value *> NamedValues;
+    std::unique_ptr<FunctionPassManager> TheFPM;
+    std::unique_ptr<LoopAnalysisManager> TheLAM;
+    std::unique_ptr<FunctionAnalysisManager> TheFAM;
+    std::unique_ptr<CGSCCAnalysisManager> TheCGAM;
+    std::unique_ptr<ModuleAnalysisManager> TheMAM;
+    std::unique_ptr<PassInstrumentationCallbacks> ThePIC;
+    std::unique_ptr<StandardInstrumentations> TheSI;
+    std::map<std::string, std::unique_ptr<PrototypeAST>> FunctionProtos;
+
+    /// FunctionDefs - ASTs of every def, kept so a def can be emitted again
+    /// as a private copy next to a batch-call wrapper.
+    std::map<std::string, std::unique_ptr<FunctionAST>> FunctionDefs;
+    std::map<std::string, BatchCallFn> BatchCalls;
+    bool EmittingCopy = false; // no profile counters or reports for copies
+
+    // JIT
+    KaleidoscopeJIT &JIT;
+    JITDylib &JD;
+
+    /// PendingExprs - Top-level expressions codegen'd in batch mode, run in
+    /// order once the whole module has been optimized.
+    std::vector<std::pair<std::string, VarType>> PendingExprs;
+
+    // Profile-guided optimization
+    std::map<std::string, std::unique_ptr<FunctionCounters>> ProfileCounters;
+    FunctionCounters *CurCounters = nullptr;           // -profile-generate
+    const std::vector<uint64_t> *CurProfile = nullptr; // -profile-use
+    unsigned CurIfIndex = 0;
+
+    // Memoization (-memoize)
+    std::map<std::string, std::unique_ptr<FunctionCounters>> MemoCounters;
+    StructType *CurMemoType = nullptr;
+    Value *CurMemoSlot = nullptr; // null: the current function has no cache
+    std::vector<Value *> CurMemoKeys;
+
+    // Phase timing (-time-phases)
+    double PhaseSeconds[num_phases] = {};
+    CompilePhase CurPhase = phase_none;
+    std::chrono::steady_clock::time_point PhaseStart =
+        std::chrono::steady_clock::now();
+
+    /// enterPhase - Charge the time since the last switch to CurPhase and
+    /// start charging P.
+    void enterPhase(CompilePhase P) {
+        auto Now = std::chrono::steady_clock::now();
+        PhaseSeconds[CurPhase] +=
+            std::chrono::duration<double>(Now - PhaseStart).count();
+        CurPhase = P;
+        PhaseStart = Now;
+    }
 };
 
-static std::string IdentifierStr;
-static double NumVal;
+/// PhaseScope - Charge wall time to one phase for the lifetime of the scope,
+/// then resume the enclosing one. Nested scopes (e.g. the function passes run
+/// from within codegen) are therefore never counted twice.
+class PhaseScope {
+    Session &S;
+    CompilePhase Prev;
+
+public:
+    PhaseScope(Session &S, CompilePhase P) : S(S), Prev(S.CurPhase) {
+        S.enterPhase(P);
+    }
+    ~PhaseScope() { S.enterPhase(Prev); }
+};
 
-static int gettok(){
-    static int LastChar = ' ';
 
+static int gettok(Session &S){
     // skip spaces
-    while (isspace(LastChar)){
-        LastChar = getchar();
+    while (isspace(S.LastChar)){
+        S.LastChar = S.In.get();
     }
 
     // Get identifier
-    if (isalpha(LastChar)){
-        IdentifierStr = LastChar;
-        while (isalnum((LastChar = getchar()))) {
-            IdentifierStr += LastChar;
+    if (isalpha(S.LastChar)){
+        S.IdentifierStr = S.LastChar;
+        while (isalnum((S.LastChar = S.In.get()))) {
+            S.IdentifierStr += S.LastChar;
         }
 
-        if (IdentifierStr == "def"){
+        if (S.IdentifierStr == "def"){
             return tok_def;
         }
-        if (IdentifierStr == "extern"){
+        if (S.IdentifierStr == "extern"){
             return tok_extern;
         }
+        if (S.IdentifierStr == "if"){
+            return tok_if;
+        }
+        if (S.IdentifierStr == "then"){
+            return tok_then;
+        }
+        if (S.IdentifierStr == "else"){
+            return tok_else;
+        }
         return tok_identifier;
     }
 
-    if (isdigit(LastChar) || LastChar == '.') {
+    if (isdigit(S.LastChar) || S.LastChar == '.') {
         std::string NumStr;
         do {
-            NumStr += LastChar;
-            LastChar = getchar();
-        } while (isdigit(LastChar) || LastChar == '.');
-        NumVal = strtod(NumStr.c_str(), 0);
+            NumStr += S.LastChar;
+            S.LastChar = S.In.get();
+        } while (isdigit(S.LastChar) || S.LastChar == '.');
+        S.NumIsInt = NumStr.find('.') == std::string::npos;
+        if (S.NumIsInt) {
+            // strtod 을 거치면 2^53 이상에서 값이 뭉개지므로 정수는 따로 읽는다
+            errno = 0;
+            S.IntVal = strtoll(NumStr.c_str(), 0, 10);
+            S.NumOutOfRange = errno == ERANGE;
+        } else {
+            S.NumVal = strtod(NumStr.c_str(), 0);
+        }
         return tok_number;
     }
 
-    if (LastChar == '#'){
+    if (S.LastChar == '#'){
         do{
-            LastChar = getchar();
-        } while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
-    }
-    if (LastChar != EOF) {
-        return gettok();
+            S.LastChar = S.In.get();
+        } while (S.LastChar != EOF && S.LastChar != '\n' && S.LastChar != '\r');
+
+        if (S.LastChar != EOF) {
+            return gettok(S);
+        }
     }
 
-    if (LastChar == EOF){
+    if (S.LastChar == EOF){
         return tok_eof;
     }
 
-    int ThisChar = LastChar;
-    LastChar = getchar();
+    int ThisChar = S.LastChar;
+    S.LastChar = S.In.get();
     return ThisChar;
 }
 
@@ -89,94 +305,53 @@ static int gettok(){
 // }
 
 
-class ExprAST {
-public:
-    virtual ~ExprAST() {}
-    virtual Value *codegen() = 0;
-};
+//===----------------------------------------------------------------------===//
+// Abstract Syntax Tree
+//===----------------------------------------------------------------------===//
 
+typedef std::map<std::string, VarType> TypeEnv;
 
-class IfExprAST : public ExprAST {
-    std::unique_ptr<ExprAST> Cond, Then, Else;
+namespace {
 
+class ExprAST {
 public:
-    IfExprAST(std::unique_ptr<ExprAST> Cod, std::unique_ptr<ExprAST> Then,
-                std::unique_ptr<ExprAST> Else)
-    : Cond(std::move(COnd)), Then(std::move(Then)), Else(std::move(Else)) {}
-
-    Value *codegen() override;
-};
-
-static std::unique_ptr<ExprAST> ParseIfExpr() {
-    getNextToken(); // 'if' move next token
-    
-    auto Cond = ParseExpression(); // 조건 부분 파싱
-    if (!Cond) return nullptr;
-
-    if (CurTok != tok_then) return LogError("expected then");
-    getNextToken();
-
-    auto Then = ParseExpression();
-    if (!Then) return nullptr;
-
-    if (CurTok != tok_else) return LogError("expected then");
-    getNextToken();
-
-    auto Else = ParseExpression();
-    if (!Else) return nullptr;
-
-    return std::make_unique<IfExprAST>(
-        std::move(Cond), std::move(Then), std::move(Else)
-    );
-}
-
-Value *IfExprAST::codegen(){
-    Value *CondV = Cond -> codegen();
-    if (!CondV) return nullptr;
-
-    CondV = Builder -> CreateFCmpONE(
-        CondV, ConstantFP::get(*TheContext, APFloat(0.0)), "ifcond");
-    
-    Function *TheFunction = Builder -> GetInsertBlock() -> getParent();
-
-    BasicBlock *ThenBB = BasicBlock::Create(*TheContext, "then", TheFunction);
-    BasicBlock *ElseBB = BasicBlock::Create(*TheContext, "else");
-    BasicBlock *MergeBB = BasicBlock::Create(*TheContext, "ifcont");
-    
-    Builder -> CreateCondBr(CondV, ThenBB, ElseBB);
-
-    Builder -> SetInsertPoint(ThenBB);
-
-    Value *ThenV = Then -> codegen();
-    if (!ThenV)
-        return nullptr;
-    
-    Builder -> CreateBr(MergeBB);
-    ThenBB = Builder->GetInsertBlock();
-
-    TheFunction -> Insert(TheFunction -> end(), ElseBB);
-    Builder -> SetInsertPoint(ElseBB);
-
-    Value *ElseV = Else -> codegen();
+    virtual ~ExprAST() {}
+    virtual Value *codegen(Session &S) = 0;
 
+    /// inferType - Static type of this expression, given the argument types
+    /// in Env. Self is the function whose return type is being inferred; a
+    /// call to it yields type_unknown.
+    virtual VarType inferType(Session &S, const TypeEnv &Env,
+                              const std::string &Self) = 0;
 
-}
+    /// markTailPosition - This expression's value is the function's result.
+    /// Only 'if' arms and calls care; operands of anything else never are.
+    virtual void markTailPosition() {}
 
+    /// isPure - Evaluating this has no side effects: it calls only defs
+    /// already known to be pure, or Self, and never an extern.
+    virtual bool isPure(Session &, const std::string &) const { return true; }
 
+    /// callsSelf - Some call in this expression is to Self.
+    virtual bool callsSelf(const std::string &) const { return false; }
+};
 
 
 class NumberExprAST : public ExprAST {
-    double Val;
+    double Val = 0;
+    int64_t IntVal = 0;
+    bool IsInt;
 
 public:
-    NumberExprAST(double V) : Val(V) {}
-    virtual Value *codegen();
+    NumberExprAST(double V) : Val(V), IsInt(false) {}
+    NumberExprAST(int64_t V) : IntVal(V), IsInt(true) {}
+    Value *codegen(Session &S) override;
+    VarType inferType(Session &, const TypeEnv &,
+                      const std::string &) override {
+        return IsInt ? type_int : type_double;
+    }
 };
 
-Value *NumberExprAST::codegen() {
-    return ConstantFP::get(TheContext, APFloat(Val));
-}
-
 
 /// VariableExprAST - Expression class for referencing a variable, like "a".
 class VariableExprAST : public ExprAST {
@@ -184,18 +359,17 @@ class VariableExprAST : public ExprAST {
 
 public:
   VariableExprAST(const std::string &Name) : Name(Name) {}
+  Value *codegen(Session &S) override;
+  VarType inferType(Session &, const TypeEnv &Env,
+                    const std::string &) override {
+      auto I = Env.find(Name);
+      return I == Env.end() ? type_unknown : I->second;
+  }
 };
 
-Value *VariableExprAST::codegen() {
-    Value *V = NamedValues[Name];
-    if (!V) {
-        LogError("Unknown variable name");
-    }
-    return V;
-}
 
 class BinaryExprAST : public ExprAST {
-    char Op; // + - * / > <
+    char Op; // + - * / % < > & |
     std::unique_ptr<ExprAST> LHS, RHS;
 public:
     BinaryExprAST(
@@ -203,48 +377,106 @@ public:
         std::unique_ptr<ExprAST> LHS,
         std::unique_ptr<ExprAST> RHS
     ): Op(op), LHS(std::move(LHS)), RHS(std::move(RHS)) {}
-};
-
-Value *BinaryExprAST::codegen() {
-    Value *L = LHS -> codegen();
-    Value *R = RHS -> codegen();
-    if (!L || !R){
-        return nullptr;
+    Value *codegen(Session &S) override;
+    VarType inferType(Session &S, const TypeEnv &Env,
+                      const std::string &Self) override {
+        return binaryResultType(Op, LHS->inferType(S, Env, Self),
+                                RHS->inferType(S, Env, Self));
     }
-
-    switch(Op){
-        case '+':
-            return Builder.CreateFAdd(L, R, "addtmp");
-        case '-':
-            return Builder.CreateFAdd(L, R, "subtmp");
-        case '*':
-            return Builder.CreateFAdd(L, R, "multmp");
-        case '<':
-            L = Builder.CreateUIToFP(L, Type::getDoubleTy)
+    bool isPure(Session &S, const std::string &Self) const override {
+        return LHS->isPure(S, Self) && RHS->isPure(S, Self);
     }
-}
+    bool callsSelf(const std::string &Self) const override {
+        return LHS->callsSelf(Self) || RHS->callsSelf(Self);
+    }
+};
 
 
 class CallExprAST : public ExprAST {
   std::string Callee;
   std::vector<std::unique_ptr<ExprAST>> Args;
+  bool IsTail = false;
 
 public:
   CallExprAST(const std::string &Callee,
               std::vector<std::unique_ptr<ExprAST>> Args)
     : Callee(Callee), Args(std::move(Args)) {}
+  Value *codegen(Session &S) override;
+  VarType inferType(Session &S, const TypeEnv &Env,
+                    const std::string &Self) override;
+  void markTailPosition() override { IsTail = true; }
+  bool isPure(Session &S, const std::string &Self) const override;
+  bool callsSelf(const std::string &Self) const override {
+    if (Callee == Self)
+      return true;
+    for (auto &Arg : Args)
+      if (Arg->callsSelf(Self))
+        return true;
+    return false;
+  }
+};
+
+
+class IfExprAST : public ExprAST {
+    std::unique_ptr<ExprAST> Cond, Then, Else;
+
+public:
+    IfExprAST(std::unique_ptr<ExprAST> Cond, std::unique_ptr<ExprAST> Then,
+                std::unique_ptr<ExprAST> Else)
+    : Cond(std::move(Cond)), Then(std::move(Then)), Else(std::move(Else)) {}
+
+    Value *codegen(Session &S) override;
+    VarType inferType(Session &S, const TypeEnv &Env,
+                      const std::string &Self) override {
+        return unifyTypes(Then->inferType(S, Env, Self),
+                          Else->inferType(S, Env, Self));
+    }
+    void markTailPosition() override {
+        Then->markTailPosition();
+        Else->markTailPosition();
+    }
+    bool isPure(Session &S, const std::string &Self) const override {
+        return Cond->isPure(S, Self) && Then->isPure(S, Self) &&
+               Else->isPure(S, Self);
+    }
+    bool callsSelf(const std::string &Self) const override {
+        return Cond->callsSelf(Self) || Then->callsSelf(Self) ||
+               Else->callsSelf(Self);
+    }
 };
 
 
+/// PrototypeAST - "name(arg:type ...):type". Arguments and the return value
+/// default to double; an unannotated 'def' has its return type inferred
+/// from the body.
 class PrototypeAST {
   std::string Name;
   std::vector<std::string> Args;
+  std::vector<VarType> ArgTypes;
+  VarType RetType;
+  bool Pure = false; // set for defs whose body is pure; externs never are
 
 public:
-  PrototypeAST(const std::string &Name, std::vector<std::string> Args)
-    : Name(Name), Args(std::move(Args)) {}
+  PrototypeAST(const std::string &Name, std::vector<std::string> Args,
+               std::vector<VarType> ArgTypes, VarType RetType)
+    : Name(Name), Args(std::move(Args)), ArgTypes(std::move(ArgTypes)),
+      RetType(RetType) {}
 
+  Function *codegen(Session &S);
   const std::string &getName() const { return Name; }
+  const std::vector<std::string> &getArgs() const { return Args; }
+  VarType getArgType(unsigned i) const { return ArgTypes[i]; }
+  VarType getRetType() const { return RetType; }
+  void setRetType(VarType T) { RetType = T; }
+  bool isPure() const { return Pure; }
+  void setPure(bool P) { Pure = P; }
+
+  TypeEnv getTypeEnv() const {
+      TypeEnv Env;
+      for (unsigned i = 0; i != Args.size(); ++i)
+          Env[Args[i]] = ArgTypes[i];
+      return Env;
+  }
 };
 
 /// FunctionAST - This class represents a function definition itself.
@@ -255,77 +487,121 @@ class FunctionAST {
 public:
   FunctionAST(std::unique_ptr<PrototypeAST> Proto,
               std::unique_ptr<ExprAST> Body)
-    : Proto(std::move(Proto)), Body(std::move(Body)) {}
+    : Proto(std::move(Proto)), Body(std::move(Body)) {
+      this->Body->markTailPosition();
+  }
+  Function *codegen(Session &S);
+  const std::string &getName() const { return Proto->getName(); }
+
+private:
+  bool recursesAfterTCE(Session &S, bool &Failed);
 };
 
-static int CurTok;
-static int getNextToken(){
-    return CurTok = gettok();
+} // end anonymous namespace
+
+
+//===----------------------------------------------------------------------===//
+// Parser
+//===----------------------------------------------------------------------===//
+
+static int getNextToken(Session &S){
+    return S.CurTok = gettok(S);
 }
 
-std::unique_ptr<ExprAST> LogError(const char *Str){
-    fprintf(stderr, "LogError: &s\n", Str);
+static std::unique_ptr<ExprAST> LogError(const char *Str){
+    fprintf(stderr, "LogError: %s\n", Str);
     return nullptr;
 }
 
-std::unique_ptr<PrototypeAST> LogErrorP(const char *Str){
+static std::unique_ptr<PrototypeAST> LogErrorP(const char *Str){
     LogError(Str);
     return nullptr;
 }
 
-static std::unique_ptr<ExprAST> ParseNumberExpr(){
-    auto Result = std::make_unique<NumberExprAST>(NumVal);
-    getNextToken();
+static std::unique_ptr<ExprAST> ParseNumberExpr(Session &S){
+    if (S.NumIsInt && S.NumOutOfRange) {
+        getNextToken(S);
+        return LogError("integer literal out of range");
+    }
+    auto Result = S.NumIsInt ? std::make_unique<NumberExprAST>(S.IntVal)
+                             : std::make_unique<NumberExprAST>(S.NumVal);
+    getNextToken(S);
     return std::move(Result);
 }
 
-static std::unique_ptr<ExprAST> ParsePrimary();
-static std::unique_ptr<ExprAST> ParseBinOpRHS(int, std::unique_ptr<ExprAST>);
+static std::unique_ptr<ExprAST> ParsePrimary(Session &S);
+static std::unique_ptr<ExprAST> ParseBinOpRHS(Session &S, int,
+                                              std::unique_ptr<ExprAST>);
 
-static std::unique_ptr<ExprAST> ParseExpression() {
-    auto LHS = ParsePrimary();
+static std::unique_ptr<ExprAST> ParseExpression(Session &S) {
+    auto LHS = ParsePrimary(S);
     if (!LHS)
         return nullptr;
 
-    return ParseBinOpRHS(0, std::move(LHS));
+    return ParseBinOpRHS(S, 0, std::move(LHS));
 }
 
-static std::unique_ptr<ExprAST> ParseIdentifierExpr(){
-    std::string IdName = IdentifierStr;
-    getNextToken(); // eat identifier
+static std::unique_ptr<ExprAST> ParseIdentifierExpr(Session &S){
+    std::string IdName = S.IdentifierStr;
+    getNextToken(S); // eat identifier
 
-    if (CurTok != '(')
+    if (S.CurTok != '(')
         return std::make_unique<VariableExprAST>(IdName);
 
     // Function call
-    getNextToken(); // eat '('
+    getNextToken(S); // eat '('
     std::vector<std::unique_ptr<ExprAST>> Args;
-    if (CurTok != ')') {
+    if (S.CurTok != ')') {
         while (true) {
-            auto Arg = ParseExpression();
+            auto Arg = ParseExpression(S);
             if (!Arg) return nullptr;
             Args.push_back(std::move(Arg));
 
-            if (CurTok == ')') break;
-            if (CurTok != ',')
+            if (S.CurTok == ')') break;
+            if (S.CurTok != ',')
                 return LogError("Expected ')' or ',' in argument list");
-            getNextToken();
+            getNextToken(S);
         }
     }
-    getNextToken(); // eat ')'
+    getNextToken(S); // eat ')'
     return std::make_unique<CallExprAST>(IdName, std::move(Args));
 }
 
-static std::unique_ptr<ExprAST> ParseParenExpr();
+static std::unique_ptr<ExprAST> ParseIfExpr(Session &S) {
+    getNextToken(S); // 'if' move next token
+
+    auto Cond = ParseExpression(S); // 조건 부분 파싱
+    if (!Cond) return nullptr;
+
+    if (S.CurTok != tok_then) return LogError("expected then");
+    getNextToken(S);
+
+    auto Then = ParseExpression(S);
+    if (!Then) return nullptr;
+
+    if (S.CurTok != tok_else) return LogError("expected else");
+    getNextToken(S);
+
+    auto Else = ParseExpression(S);
+    if (!Else) return nullptr;
+
+    return std::make_unique<IfExprAST>(
+        std::move(Cond), std::move(Then), std::move(Else)
+    );
+}
+
+static std::unique_ptr<ExprAST> ParseParenExpr(Session &S);
 
-static std::unique_ptr<ExprAST> ParsePrimary(){
-    switch (CurTok){
+static std::unique_ptr<ExprAST> ParsePrimary(Session &S){
+    switch (S.CurTok){
         case tok_identifier:
-            return ParseIdentifierExpr();
+            return ParseIdentifierExpr(S);
         case tok_number:
-            return ParseNumberExpr();
+            return ParseNumberExpr(S);
         case '(':
-            return ParseParenExpr();
+            return ParseParenExpr(S);
+        case tok_if:
+            return ParseIfExpr(S);
         default:
             return LogError("unknown token when expecting an expression");
     }
@@ -333,15 +609,15 @@ static std::unique_ptr<ExprAST> ParsePrimary(){
 
 
 
-static std::unique_ptr<ExprAST> ParseParenExpr() {
-    getNextToken(); // eat '('
-    auto V = ParseExpression();
+static std::unique_ptr<ExprAST> ParseParenExpr(Session &S) {
+    getNextToken(S); // eat '('
+    auto V = ParseExpression(S);
     if (!V){
         return nullptr;
     }
 
-    if (CurTok != ')'){
-        getNextToken(); // eat ')'
+    if (S.CurTok == ')'){
+        getNextToken(S); // eat ')'
         return V;
     } else {
         return LogError("expect ')'");
@@ -351,8 +627,12 @@ static std::unique_ptr<ExprAST> ParseParenExpr() {
 
 
 
-static int GetTokPrecedence(){
-    switch (CurTok){
+static int GetTokPrecedence(Session &S){
+    switch (S.CurTok){
+        case '|':
+            return 5;
+        case '&':
+            return 6;
         case '<':
         case '>':
             return 10;
@@ -361,6 +641,7 @@ static int GetTokPrecedence(){
             return 20;
         case '*':
         case '/':
+        case '%':
             return 40;
         default:
             return -1;
@@ -370,22 +651,23 @@ static int GetTokPrecedence(){
 
 
 static std::unique_ptr<ExprAST> ParseBinOpRHS(
+    Session &S,
     int ExprPrec, // precedence number
     std::unique_ptr<ExprAST> LHS)
 {
     while (true){
-        int TokPrec = GetTokPrecedence();
+        int TokPrec = GetTokPrecedence(S);
 
         if (TokPrec < ExprPrec){
             return LHS;
         } else {
-            int BinOp = CurTok;
-            getNextToken();
-            auto RHS = ParsePrimary();
+            int BinOp = S.CurTok;
+            getNextToken(S);
+            auto RHS = ParsePrimary(S);
             if (RHS) {
-                int NextPrec = GetTokPrecedence();
+                int NextPrec = GetTokPrecedence(S);
                 if (TokPrec < NextPrec){
-                    RHS = ParseBinOpRHS(TokPrec+1, std::move(RHS));
+                    RHS = ParseBinOpRHS(S, TokPrec+1, std::move(RHS));
                     if (!RHS){
                         return nullptr;
                     }
@@ -395,45 +677,85 @@ static std::unique_ptr<ExprAST> ParseBinOpRHS(
             } else {
                     return nullptr;
                 }
-            
+
         }
     }
 }
 
-static std::unique_ptr<PrototypeAST> ParsePrototype() {
-    if (CurTok != tok_identifier){
+/// type ::= 'double' | 'int' | 'bool'
+static bool ParseType(Session &S, VarType &Ty) {
+    if (S.CurTok != tok_identifier) {
+        LogError("Expected type name after ':'");
+        return false;
+    }
+
+    if (S.IdentifierStr == "double")
+        Ty = type_double;
+    else if (S.IdentifierStr == "int")
+        Ty = type_int;
+    else if (S.IdentifierStr == "bool")
+        Ty = type_bool;
+    else {
+        LogError("Unknown type name");
+        return false;
+    }
+    getNextToken(S); // eat type name
+    return true;
+}
+
+/// prototype ::= id '(' (id (':' type)?)* ')' (':' type)?
+static std::unique_ptr<PrototypeAST> ParsePrototype(Session &S) {
+    if (S.CurTok != tok_identifier){
         return LogErrorP("Expected function name in prototype");
     }
 
-    std::string FnName = IdentifierStr;
-    getNextToken(); //eat identifier
+    std::string FnName = S.IdentifierStr;
+    getNextToken(S); //eat identifier
 
-    if (CurTok != '(')
+    if (S.CurTok != '(')
         return LogErrorP("Expected '(' in prototype");
 
     std::vector<std::string> ArgNames;
-    while (getNextToken() == tok_identifier) {
-        ArgNames.push_back(IdentifierStr);
-    if (CurTok != ')'){
+    std::vector<VarType> ArgTypes;
+    getNextToken(S); // eat '('
+    while (S.CurTok == tok_identifier) {
+        ArgNames.push_back(S.IdentifierStr);
+        ArgTypes.push_back(type_double);
+        getNextToken(S); // eat arg name
+
+        if (S.CurTok == ':') {
+            getNextToken(S); // eat ':'
+            if (!ParseType(S, ArgTypes.back()))
+                return nullptr;
+        }
+    }
+    if (S.CurTok != ')'){
         return LogErrorP("Expected ')' in prototype");
     }
 
-    getNextToken();  // eat ')'.
-
-    return std::make_unique<PrototypeAST>(FnName, std::move(ArgNames));
+    getNextToken(S);  // eat ')'.
 
+    VarType RetType = type_unknown;
+    if (S.CurTok == ':') {
+        getNextToken(S); // eat ':'
+        if (!ParseType(S, RetType))
+            return nullptr;
     }
+
+    return std::make_unique<PrototypeAST>(FnName, std::move(ArgNames),
+                                          std::move(ArgTypes), RetType);
 }
 
 
-static std::unique_ptr<FunctionAST> ParseDefinition() {
-    getNextToken(); // eat def
-    auto Proto = ParsePrototype();
+static std::unique_ptr<FunctionAST> ParseDefinition(Session &S) {
+    PhaseScope Timer(S, phase_parse);
+    getNextToken(S); // eat def
+    auto Proto = ParsePrototype(S);
     if (!Proto) {
         return nullptr;
     }
 
-    auto E = ParseExpression();
+    auto E = ParseExpression(S);
     if (E) {
         return std::make_unique<FunctionAST>(std::move(Proto), std::move(E));
     } else {
@@ -441,105 +763,1690 @@ static std::unique_ptr<FunctionAST> ParseDefinition() {
     }
 }
 
-static std::unique_ptr<PrototypeAST> ParseExtern() {
-    getNextToken(); // eat extern
-    return ParsePrototype();
+static std::unique_ptr<PrototypeAST> ParseExtern(Session &S) {
+    PhaseScope Timer(S, phase_parse);
+    getNextToken(S); // eat extern
+    auto Proto = ParsePrototype(S);
+    // extern 은 body 가 없으니 추론 불가 -> double
+    if (Proto && Proto->getRetType() == type_unknown)
+        Proto->setRetType(type_double);
+    return Proto;
 }
 
-static std::unique_ptr<FunctionAST> ParseTopLevelExpr() {
-    auto E = ParseExpression();
+
+static std::unique_ptr<FunctionAST> ParseTopLevelExpr(Session &S) {
+    PhaseScope Timer(S, phase_parse);
+    auto E = ParseExpression(S);
     if (E) {
-        auto Proto = std::make_unique<PrototypeAST>("", std::vector<std::string>());
+        // JIT 에 남아 있는 이전 식과 이름이 겹치지 않도록 번호를 붙인다.
+        std::string Name = "__anon_expr." + std::to_string(S.AnonExprCount++);
+        auto Proto = std::make_unique<PrototypeAST>(
+            Name, std::vector<std::string>(), std::vector<VarType>(),
+            type_unknown);
         return std::make_unique<FunctionAST>(std::move(Proto), std::move(E));
     }
     return nullptr;
 }
 
 
-static void HandleDefinition() {
-    if (ParseDefinition()) {
-      fprintf(stderr, "Parsed a function definition.\n");
+//===----------------------------------------------------------------------===//
+// Code Generation
+//===----------------------------------------------------------------------===//
+
+static ExitOnError ExitOnErr;
+
+static bool isBatchMode(const Session &S) {
+    return S.Opts.IPO || !S.Opts.OutputFilename.empty();
+}
+
+static Value *LogErrorV(const char *Str) {
+    LogError(Str);
+    return nullptr;
+}
+
+static Type *getLLVMType(Session &S, VarType T) {
+    switch (T) {
+        case type_int:
+            return Type::getInt64Ty(*S.TheContext);
+        case type_bool:
+            return Type::getInt1Ty(*S.TheContext);
+        default:
+            return Type::getDoubleTy(*S.TheContext);
+    }
+}
+
+static VarType getVarType(Type *Ty) {
+    if (Ty->isIntegerTy(1))
+        return type_bool;
+    if (Ty->isIntegerTy())
+        return type_int;
+    return type_double;
+}
+
+/// convertTo - Emit the conversion of V to type T. bool widens to 0/1,
+/// and anything narrows to bool by comparing against zero.
+static Value *convertTo(Session &S, Value *V, VarType T) {
+    VarType From = getVarType(V->getType());
+    if (From == T)
+        return V;
+
+    switch (T) {
+        case type_bool:
+            if (From == type_double)
+                return S.Builder->CreateFCmpONE(
+                    V, ConstantFP::get(*S.TheContext, APFloat(0.0)), "tobool");
+            return S.Builder->CreateICmpNE(
+                V, ConstantInt::get(V->getType(), 0), "tobool");
+        case type_int:
+            // fptosi 는 NaN 이나 범위 밖 값에서 poison 이므로 saturating 버전
+            // (NaN -> 0, 넘치면 INT64_MIN/MAX) 을 쓴다.
+            if (From == type_double)
+                return S.Builder->CreateIntrinsic(
+                    Intrinsic::fptosi_sat, {getLLVMType(S, type_int),
+                                            V->getType()},
+                    {V}, nullptr, "toint");
+            return S.Builder->CreateZExt(V, getLLVMType(S, type_int), "toint");
+        default:
+            if (From == type_bool)
+                return S.Builder->CreateUIToFP(V, getLLVMType(S, type_double),
+                                               "todouble");
+            return S.Builder->CreateSIToFP(V, getLLVMType(S, type_double),
+                                           "todouble");
+    }
+}
+
+
+//===----------------------------------------------------------------------===//
+// Profile-guided optimization
+//===----------------------------------------------------------------------===//
+
+// 한 함수의 카운터: [0] = 진입 횟수, 이후 'if' 마다 (then, else) 두 칸.
+// 'if' 순서는 codegen 순서이므로 같은 소스면 항상 같은 칸을 가리킨다.
+
+struct ProfileData {
+    std::map<std::string, std::vector<uint64_t>> Counts;
+    std::unique_ptr<ProfileSummary> Summary;
+};
+
+/// emitCounterIncrement - "++*Counter" against the host address of Counter;
+/// the JIT'd code runs in this process so no symbol is needed.
+static void emitCounterIncrement(Session &S, uint64_t *Counter) {
+    Type *I64 = Type::getInt64Ty(*S.TheContext);
+    Value *Addr = S.Builder->CreateIntToPtr(
+        ConstantInt::get(I64, (uint64_t)(uintptr_t)Counter),
+        PointerType::getUnqual(I64));
+    Value *Old = S.Builder->CreateLoad(I64, Addr, "prof.old");
+    S.Builder->CreateStore(
+        S.Builder->CreateAdd(Old, ConstantInt::get(I64, 1), "prof.new"), Addr);
+}
+
+/// scaleWeight - Branch weights are 32-bit; keep the ratio of large counts.
+static uint32_t scaleWeight(uint64_t Count, uint64_t Max) {
+    uint64_t Scale = Max / UINT32_MAX + 1;
+    return (uint32_t)(Count / Scale);
+}
+
+bool writeProfile(Session &S, const std::string &Filename) {
+    std::ofstream Out(Filename);
+    if (!Out) {
+        fprintf(stderr, "Could not write profile %s\n", Filename.c_str());
+        return false;
+    }
+    Out << "# my-lang profile: name entry (then else)*\n";
+    for (auto &P : S.ProfileCounters) {
+        Out << P.first;
+        for (uint64_t C : *P.second)
+            Out << ' ' << C;
+        Out << '\n';
+    }
+    return true;
+}
+
+std::shared_ptr<const ProfileData> readProfile(const std::string &Filename) {
+    std::ifstream In(Filename);
+    if (!In) {
+        fprintf(stderr, "Could not read profile %s\n", Filename.c_str());
+        return nullptr;
+    }
+
+    auto Profile = std::make_shared<ProfileData>();
+    InstrProfSummaryBuilder SummaryBuilder(ProfileSummaryBuilder::DefaultCutoffs);
+    std::string Line;
+    while (std::getline(In, Line)) {
+        if (Line.empty() || Line[0] == '#')
+            continue;
+        std::istringstream LS(Line);
+        std::string Name;
+        std::vector<uint64_t> Counts;
+        uint64_t C;
+        LS >> Name;
+        while (LS >> C)
+            Counts.push_back(C);
+        if (Counts.empty() || Counts.size() % 2 != 1) {
+            fprintf(stderr, "Malformed profile entry for '%s'\n", Name.c_str());
+            continue;
+        }
+        SummaryBuilder.addRecord(InstrProfRecord(Counts));
+        Profile->Counts[Name] = std::move(Counts);
+    }
+    Profile->Summary = SummaryBuilder.getSummary();
+    return Profile;
+}
+
+/// beginFunctionProfile - Called once the entry block of F is current.
+static void beginFunctionProfile(Session &S, Function *F) {
+    S.CurIfIndex = 0;
+    S.CurCounters = nullptr;
+    S.CurProfile = nullptr;
+
+    // Top-level expressions run once and are numbered in the order they are
+    // read; a count recorded under one name says nothing about the next run,
+    // and their counters would outlive the code once it is freed.
+    if (F->getName().startswith("__anon_expr"))
+        return;
+
+    std::string Name = std::string(F->getName());
+    if (S.Opts.ProfileGenerate && !S.EmittingCopy) {
+        auto &Counters = S.ProfileCounters[Name];
+        Counters = std::make_unique<FunctionCounters>(1, 0);
+        S.CurCounters = Counters.get();
+        emitCounterIncrement(S, &S.CurCounters->front());
+    }
+
+    if (!S.Opts.ProfileUse)
+        return;
+    auto PI = S.Opts.ProfileUse->Counts.find(Name);
+    if (PI != S.Opts.ProfileUse->Counts.end()) {
+        S.CurProfile = &PI->second;
+        F->setEntryCount((*S.CurProfile)[0]);
+    }
+}
+
+/// finishFunctionProfile - Drop weights that came from a profile recorded
+/// for a different body of the same name.
+static void finishFunctionProfile(Session &S, Function *F) {
+    if (S.CurProfile && S.CurProfile->size() != 1 + 2 * S.CurIfIndex) {
+        fprintf(stderr, "Profile for '%s' does not match its body; ignored\n",
+                F->getName().str().c_str());
+        for (Instruction &I : instructions(*F))
+            I.setMetadata(LLVMContext::MD_prof, nullptr);
+        F->setMetadata(LLVMContext::MD_prof, nullptr);
+    }
+    S.CurCounters = nullptr;
+    S.CurProfile = nullptr;
+}
+
+/// reportRemainingRecursion - After the function pipeline, every self call
+/// still present uses a stack frame. Say which and why.
+static void reportRemainingRecursion(Function &F) {
+    unsigned InTail = 0, NotTail = 0;
+    for (Instruction &I : instructions(F)) {
+        auto *CI = dyn_cast<CallInst>(&I);
+        if (!CI || CI->getCalledFunction() != &F)
+            continue;
+        if (CI->getMetadata("mylang.tailpos"))
+            ++InTail;
+        else
+            ++NotTail;
+    }
+
+    std::string Name = std::string(F.getName());
+    if (InTail)
+        fprintf(stderr,
+                "tail-call: '%s': %u call(s) in tail position not converted "
+                "(result is converted or used after the call)\n",
+                Name.c_str(), InTail);
+    if (NotTail)
+        fprintf(stderr,
+                "tail-call: '%s': %u recursive call(s) not in tail position\n",
+                Name.c_str(), NotTail);
+}
+
+// 캐시 한 칸: { 인자 비트들 [N x i64], 결과, valid(i8) }. 직접 사상(direct
+// mapped)이라 충돌하면 그냥 덮어쓴다. 적중/실패 횟수는 PGO 카운터처럼 host
+// 메모리에 센다 (-o 로 object 를 쓸 때는 세지 않는다).
+
+/// beginMemoizedFunction - Called with the entry block of F current. For a
+/// memoizable def under -memoize, emit the cache probe (returning early on a
+/// hit) and leave the builder in the block that computes the result.
+static void beginMemoizedFunction(Session &S, Function *F, bool Memoizable) {
+    S.CurMemoSlot = nullptr;
+    if (!S.Opts.Memoize || !Memoizable || S.EmittingCopy || F->arg_empty())
+        return;
+
+    LLVMContext &Ctx = *S.TheContext;
+    Type *I64 = Type::getInt64Ty(Ctx);
+    Type *RetTy = F->getReturnType();
+    unsigned Bits = Log2_64_Ceil(std::max<uint64_t>(2, S.Opts.MemoizeSlots));
+
+    auto *KeysTy = ArrayType::get(I64, F->arg_size());
+    auto *EntryTy = StructType::get(Ctx, {KeysTy, RetTy, Type::getInt8Ty(Ctx)});
+    auto *TableTy = ArrayType::get(EntryTy, uint64_t(1) << Bits);
+    auto *Table = new GlobalVariable(
+        *S.TheModule, TableTy, false, GlobalValue::InternalLinkage,
+        ConstantAggregateZero::get(TableTy), F->getName() + ".memo");
+
+    FunctionCounters *Counters = nullptr;
+    if (S.Opts.OutputFilename.empty()) {
+        auto &C = S.MemoCounters[F->getName().str()];
+        if (!C)
+            C = std::make_unique<FunctionCounters>(2, 0); // hits, misses
+        Counters = C.get();
+    }
+
+    // Hash the argument bits (Fibonacci hashing) and pick the slot.
+    std::vector<Value *> Keys;
+    Value *Hash = ConstantInt::get(I64, 0);
+    for (auto &Arg : F->args()) {
+        Value *K = Arg.getType()->isDoubleTy()
+                       ? S.Builder->CreateBitCast(&Arg, I64)
+                       : S.Builder->CreateZExt(&Arg, I64);
+        Keys.push_back(K);
+        Hash = S.Builder->CreateMul(S.Builder->CreateXor(Hash, K),
+                                    ConstantInt::get(I64, 0x9E3779B97F4A7C15));
+    }
+    Value *Index = S.Builder->CreateLShr(Hash, 64 - Bits, "memo.idx");
+    Value *Slot = S.Builder->CreateInBoundsGEP(
+        TableTy, Table, {ConstantInt::get(I64, 0), Index}, "memo.slot");
+
+    Value *Hit = S.Builder->CreateICmpNE(
+        S.Builder->CreateLoad(Type::getInt8Ty(Ctx),
+                              S.Builder->CreateStructGEP(EntryTy, Slot, 2)),
+        ConstantInt::get(Type::getInt8Ty(Ctx), 0));
+    Value *KeysPtr = S.Builder->CreateStructGEP(EntryTy, Slot, 0);
+    for (unsigned i = 0; i != Keys.size(); ++i)
+        Hit = S.Builder->CreateAnd(
+            Hit, S.Builder->CreateICmpEQ(
+                     S.Builder->CreateLoad(
+                         I64, S.Builder->CreateConstInBoundsGEP2_64(
+                                  KeysTy, KeysPtr, 0, i)),
+                     Keys[i]));
+
+    BasicBlock *HitBB = BasicBlock::Create(Ctx, "memo.hit", F);
+    BasicBlock *MissBB = BasicBlock::Create(Ctx, "memo.miss", F);
+    S.Builder->CreateCondBr(Hit, HitBB, MissBB);
+
+    S.Builder->SetInsertPoint(HitBB);
+    if (Counters)
+        emitCounterIncrement(S, &(*Counters)[0]);
+    S.Builder->CreateRet(S.Builder->CreateLoad(
+        RetTy, S.Builder->CreateStructGEP(EntryTy, Slot, 1)));
+
+    S.Builder->SetInsertPoint(MissBB);
+    if (Counters)
+        emitCounterIncrement(S, &(*Counters)[1]);
+
+    S.CurMemoType = EntryTy;
+    S.CurMemoSlot = Slot;
+    S.CurMemoKeys = Keys;
+}
+
+/// finishMemoizedFunction - Store RetVal, the function's result, in the
+/// slot probed on entry.
+static void finishMemoizedFunction(Session &S, Value *RetVal) {
+    if (!S.CurMemoSlot)
+        return;
+    auto *EntryTy = S.CurMemoType;
+    Value *KeysPtr = S.Builder->CreateStructGEP(EntryTy, S.CurMemoSlot, 0);
+    Type *KeysTy = EntryTy->getElementType(0);
+    for (unsigned i = 0; i != S.CurMemoKeys.size(); ++i)
+        S.Builder->CreateStore(
+            S.CurMemoKeys[i],
+            S.Builder->CreateConstInBoundsGEP2_64(KeysTy, KeysPtr, 0, i));
+    S.Builder->CreateStore(RetVal,
+                           S.Builder->CreateStructGEP(EntryTy, S.CurMemoSlot, 1));
+    S.Builder->CreateStore(ConstantInt::get(EntryTy->getElementType(2), 1),
+                           S.Builder->CreateStructGEP(EntryTy, S.CurMemoSlot, 2));
+    S.CurMemoSlot = nullptr;
+}
+
+/// reportMemoStats - Hit/miss counts of every memoized def in S.
+static void reportMemoStats(Session &S) {
+    for (auto &M : S.MemoCounters)
+        fprintf(stderr, "memo: '%s': hits=%llu misses=%llu\n",
+                M.first.c_str(), (unsigned long long)(*M.second)[0],
+                (unsigned long long)(*M.second)[1]);
+}
+
+static Function *getFunction(Session &S, std::string Name) {
+    // First, see if the function has already been added to the current module.
+    if (auto *F = S.TheModule->getFunction(Name))
+        return F;
+
+    // If not, check whether we can codegen the declaration from some existing
+    // prototype.
+    auto FI = S.FunctionProtos.find(Name);
+    if (FI != S.FunctionProtos.end())
+        return FI->second->codegen(S);
+
+    // If no existing prototype exists, return null.
+    return nullptr;
+}
+
+VarType CallExprAST::inferType(Session &S, const TypeEnv &, const std::string &Self) {
+    if (Callee == Self)
+        return type_unknown;
+    auto FI = S.FunctionProtos.find(Callee);
+    if (FI == S.FunctionProtos.end())
+        return type_unknown;
+    return FI->second->getRetType();
+}
+
+Value *NumberExprAST::codegen(Session &S) {
+    if (IsInt)
+        return ConstantInt::get(getLLVMType(S, type_int), IntVal, true);
+    return ConstantFP::get(*S.TheContext, APFloat(Val));
+}
+
+Value *VariableExprAST::codegen(Session &S) {
+    Value *V = S.NamedValues[Name];
+    if (!V) {
+        return LogErrorV("Unknown variable name");
+    }
+    return V;
+}
+
+/// emitIntDivRem - i64 '/' and '%' with every input defined: x / 0 is 0,
+/// x % 0 is x, and x / -1 is -x (wrapping, so INT64_MIN / -1 is INT64_MIN),
+/// which keeps x == (x / y) * y + x % y. sdiv/srem would trap or be UB on
+/// those inputs, so they only ever see a divisor that is neither 0 nor -1.
+static Value *emitIntDivRem(Session &S, char Op, Value *L, Value *R) {
+    Type *I64 = L->getType();
+    Value *IsZero = S.Builder->CreateICmpEQ(R, ConstantInt::get(I64, 0),
+                                            "divzero");
+    Value *IsNegOne = S.Builder->CreateICmpEQ(
+        R, ConstantInt::get(I64, -1, true), "divnegone");
+    Value *Den = S.Builder->CreateSelect(
+        S.Builder->CreateOr(IsZero, IsNegOne), ConstantInt::get(I64, 1), R,
+        "divisor");
+    if (Op == '/') {
+        Value *Q = S.Builder->CreateSDiv(L, Den, "divtmp");
+        Q = S.Builder->CreateSelect(IsNegOne, S.Builder->CreateNeg(L), Q);
+        return S.Builder->CreateSelect(IsZero, ConstantInt::get(I64, 0), Q,
+                                       "divtmp");
+    }
+    Value *Rem = S.Builder->CreateSRem(L, Den, "remtmp");
+    return S.Builder->CreateSelect(IsZero, L, Rem, "remtmp");
+}
+
+Value *BinaryExprAST::codegen(Session &S) {
+    Value *L = LHS -> codegen(S);
+    Value *R = RHS -> codegen(S);
+    if (!L || !R){
+        return nullptr;
+    }
+
+    VarType LT = getVarType(L->getType());
+    VarType RT = getVarType(R->getType());
+    VarType OpT = unifyTypes(LT, RT);
+
+    if (isBitwiseOp(Op)) {
+        if (!isIntegral(OpT))
+            return LogErrorV("bitwise operator on double operand");
+        // bool & bool 은 i1 그대로, 그 외는 i64 로
+        if (OpT == type_int) {
+            L = convertTo(S, L, type_int);
+            R = convertTo(S, R, type_int);
+        }
+        if (Op == '&')
+            return S.Builder->CreateAnd(L, R, "andtmp");
+        return S.Builder->CreateOr(L, R, "ortmp");
+    }
+
+    // 정수끼리면 i64 연산, 하나라도 double 이면 double 연산
+    if (isIntegral(OpT)) {
+        L = convertTo(S, L, type_int);
+        R = convertTo(S, R, type_int);
+        switch(Op){
+            case '+':
+                return S.Builder->CreateAdd(L, R, "addtmp");
+            case '-':
+                return S.Builder->CreateSub(L, R, "subtmp");
+            case '*':
+                return S.Builder->CreateMul(L, R, "multmp");
+            case '/':
+            case '%':
+                return emitIntDivRem(S, Op, L, R);
+            case '<':
+                return S.Builder->CreateICmpSLT(L, R, "cmptmp");
+            case '>':
+                return S.Builder->CreateICmpSGT(L, R, "cmptmp");
+            default:
+                return LogErrorV("invalid binary operator");
+        }
+    }
+
+    L = convertTo(S, L, type_double);
+    R = convertTo(S, R, type_double);
+    switch(Op){
+        case '+':
+            return S.Builder->CreateFAdd(L, R, "addtmp");
+        case '-':
+            return S.Builder->CreateFSub(L, R, "subtmp");
+        case '*':
+            return S.Builder->CreateFMul(L, R, "multmp");
+        case '/':
+            return S.Builder->CreateFDiv(L, R, "divtmp");
+        case '%':
+            return S.Builder->CreateFRem(L, R, "remtmp");
+        case '<':
+            return S.Builder->CreateFCmpULT(L, R, "cmptmp");
+        case '>':
+            return S.Builder->CreateFCmpUGT(L, R, "cmptmp");
+        default:
+            return LogErrorV("invalid binary operator");
+    }
+}
+
+bool CallExprAST::isPure(Session &S, const std::string &Self) const {
+    if (Callee != Self) {
+        auto FI = S.FunctionProtos.find(Callee);
+        if (FI == S.FunctionProtos.end() || !FI->second->isPure())
+            return false;
+    }
+    for (auto &Arg : Args)
+        if (!Arg->isPure(S, Self))
+            return false;
+    return true;
+}
+
+Value *CallExprAST::codegen(Session &S) {
+    // Look up the name in the global module table.
+    Function *CalleeF = getFunction(S, Callee);
+    if (!CalleeF)
+        return LogErrorV("Unknown function referenced");
+
+    // If argument mismatch error.
+    if (CalleeF->arg_size() != Args.size())
+        return LogErrorV("Incorrect # arguments passed");
+
+    std::vector<Value *> ArgsV;
+    for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+        Value *ArgV = Args[i]->codegen(S);
+        if (!ArgV)
+            return nullptr;
+        ArgsV.push_back(convertTo(S,
+            ArgV, getVarType(CalleeF->getArg(i)->getType())));
+    }
+
+    CallInst *CI = S.Builder->CreateCall(CalleeF, ArgsV, "calltmp");
+
+    // 자기 자신을 tail 위치에서 부르면 'tail' 로 표시해 TailCallElim 이
+    // 루프로 바꾸게 한다. 표시는 리포트용 metadata 로도 남긴다.
+    if (IsTail && CalleeF == S.Builder->GetInsertBlock()->getParent()) {
+        CI->setTailCall();
+        CI->setMetadata("mylang.tailpos", MDNode::get(*S.TheContext, None));
+    }
+    return CI;
+}
+
+Value *IfExprAST::codegen(Session &S){
+    Value *CondV = Cond -> codegen(S);
+    if (!CondV) return nullptr;
+
+    // 조건이 이미 bool 이면 비교 없이 바로 분기
+    CondV = convertTo(S, CondV, type_bool);
+
+    Function *TheFunction = S.Builder -> GetInsertBlock() -> getParent();
+
+    BasicBlock *ThenBB = BasicBlock::Create(*S.TheContext, "then", TheFunction);
+    BasicBlock *ElseBB = BasicBlock::Create(*S.TheContext, "else");
+    BasicBlock *MergeBB = BasicBlock::Create(*S.TheContext, "ifcont");
+
+    unsigned Slot = 1 + 2 * S.CurIfIndex++;
+    BranchInst *Br = S.Builder -> CreateCondBr(CondV, ThenBB, ElseBB);
+    if (S.CurProfile && Slot + 1 < S.CurProfile->size()) {
+        uint64_t T = (*S.CurProfile)[Slot], E = (*S.CurProfile)[Slot + 1];
+        uint64_t Max = std::max(T, E);
+        Br -> setMetadata(LLVMContext::MD_prof,
+                          MDBuilder(*S.TheContext).createBranchWeights(
+                              scaleWeight(T, Max), scaleWeight(E, Max)));
+    }
+    uint64_t *ThenCounter = nullptr, *ElseCounter = nullptr;
+    if (S.CurCounters) {
+        S.CurCounters->push_back(0);
+        S.CurCounters->push_back(0);
+        ThenCounter = &(*S.CurCounters)[Slot];
+        ElseCounter = &(*S.CurCounters)[Slot + 1];
+    }
+
+    S.Builder -> SetInsertPoint(ThenBB);
+    if (ThenCounter)
+        emitCounterIncrement(S, ThenCounter);
+
+    Value *ThenV = Then -> codegen(S);
+    if (!ThenV)
+        return nullptr;
+
+    // Codegen of 'Then' can change the current block.
+    ThenBB = S.Builder->GetInsertBlock();
+
+    TheFunction -> getBasicBlockList().push_back(ElseBB);
+    S.Builder -> SetInsertPoint(ElseBB);
+    if (ElseCounter)
+        emitCounterIncrement(S, ElseCounter);
+
+    Value *ElseV = Else -> codegen(S);
+    if (!ElseV)
+        return nullptr;
+
+    ElseBB = S.Builder->GetInsertBlock();
+
+    // 두 갈래의 타입을 맞춘 뒤에 merge 로 분기한다.
+    VarType PhiT = unifyTypes(getVarType(ThenV->getType()),
+                              getVarType(ElseV->getType()));
+
+    S.Builder -> SetInsertPoint(ThenBB);
+    ThenV = convertTo(S, ThenV, PhiT);
+    S.Builder -> CreateBr(MergeBB);
+
+    S.Builder -> SetInsertPoint(ElseBB);
+    ElseV = convertTo(S, ElseV, PhiT);
+    S.Builder -> CreateBr(MergeBB);
+
+    TheFunction -> getBasicBlockList().push_back(MergeBB);
+    S.Builder -> SetInsertPoint(MergeBB);
+    PHINode *PN = S.Builder -> CreatePHI(getLLVMType(S, PhiT), 2, "iftmp");
+
+    PN -> addIncoming(ThenV, ThenBB);
+    PN -> addIncoming(ElseV, ElseBB);
+    return PN;
+}
+
+Function *PrototypeAST::codegen(Session &S) {
+    std::vector<Type *> ParamTys;
+    for (VarType T : ArgTypes)
+        ParamTys.push_back(getLLVMType(S, T));
+    FunctionType *FT =
+        FunctionType::get(getLLVMType(S, RetType), ParamTys, false);
+
+    Function *F =
+        Function::Create(FT, Function::ExternalLinkage, Name, S.TheModule.get());
+
+    // Set names for all arguments.
+    unsigned Idx = 0;
+    for (auto &Arg : F->args()) {
+        Arg.setName(Args[Idx]);
+        // C ABI 에서 i1 은 zeroext 로 넘겨야 호스트 쪽 bool 과 맞는다.
+        if (ArgTypes[Idx] == type_bool)
+            Arg.addAttr(Attribute::ZExt);
+        ++Idx;
+    }
+    if (RetType == type_bool)
+        F->addRetAttr(Attribute::ZExt);
+
+    return F;
+}
+
+Function *FunctionAST::codegen(Session &S) {
+    PhaseScope Timer(S, phase_codegen);
+
+    // 반환 타입이 없으면 body 로부터 추론 (재귀 호출만 있으면 double)
+    if (Proto->getRetType() == type_unknown) {
+        VarType T = Body->inferType(S, Proto->getTypeEnv(), Proto->getName());
+        Proto->setRetType(T == type_unknown ? type_double : T);
+    }
+    Proto->setPure(Body->isPure(S, Proto->getName()));
+
+    // A recursive def is only worth a cache if it still recurses after the
+    // function pipeline. Once TailCallElim has made it a loop (tail calls,
+    // or accumulator recursion like n + f(n-1)), storing the result after
+    // the call would turn the loop back into recursion.
+    bool Memoize = S.Opts.Memoize && Proto->isPure() && !S.EmittingCopy;
+    if (Memoize && Body->callsSelf(Proto->getName())) {
+        bool Failed = false;
+        Memoize = recursesAfterTCE(S, Failed);
+        if (Failed)
+            return nullptr; // the body's error has been reported
+    }
+
+    // Register a copy of the prototype in S.FunctionProtos. The definition
+    // keeps its own so that it can be emitted again later.
+    auto &P = *Proto;
+    S.FunctionProtos[P.getName()] = std::make_unique<PrototypeAST>(P);
+    Function *TheFunction = getFunction(S, P.getName());
+    if (!TheFunction)
+        return nullptr;
+
+    // Create a new basic block to start insertion into.
+    BasicBlock *BB = BasicBlock::Create(*S.TheContext, "entry", TheFunction);
+    S.Builder->SetInsertPoint(BB);
+    beginFunctionProfile(S, TheFunction);
+
+    // Record the function arguments in the S.NamedValues map.
+    S.NamedValues.clear();
+    for (auto &Arg : TheFunction->args())
+        S.NamedValues[std::string(Arg.getName())] = &Arg;
+    beginMemoizedFunction(S, TheFunction, Memoize);
+
+    if (Value *RetVal = Body->codegen(S)) {
+        // Finish off the function.
+        RetVal = convertTo(S, RetVal, P.getRetType());
+        finishMemoizedFunction(S, RetVal);
+        S.Builder->CreateRet(RetVal);
+        finishFunctionProfile(S, TheFunction);
+
+        // Validate the generated code, checking for consistency.
+        verifyFunction(*TheFunction);
+
+        // Run the optimizer on the function.
+        {
+            PhaseScope Timer(S, phase_optimize);
+            S.TheFPM->run(*TheFunction, *S.TheFAM);
+        }
+
+        if (S.Opts.ReportTailCalls && !S.EmittingCopy)
+            reportRemainingRecursion(*TheFunction);
+
+        return TheFunction;
+    }
+
+    // Error reading body, remove function (and its cache, if any).
+    finishFunctionProfile(S, TheFunction);
+    GlobalVariable *Table = nullptr;
+    if (S.CurMemoSlot)
+        Table = cast<GlobalVariable>(
+            cast<GetElementPtrInst>(S.CurMemoSlot)->getPointerOperand());
+    S.CurMemoSlot = nullptr;
+    TheFunction->eraseFromParent();
+    if (Table) {
+        Table->eraseFromParent();
+        S.MemoCounters.erase(P.getName());
+    }
+    return nullptr;
+}
+
+/// recursesAfterTCE - Emit and optimize the def without a cache (as a copy,
+/// so without profile counters or reports), and check whether a self call
+/// is left. The trial body is removed again. Sets Failed if the body
+/// doesn't codegen.
+bool FunctionAST::recursesAfterTCE(Session &S, bool &Failed) {
+    S.EmittingCopy = true;
+    Function *Trial = codegen(S);
+    S.EmittingCopy = false;
+    if (!Trial) {
+        Failed = true;
+        return false;
+    }
+
+    bool Recurses = false;
+    for (Instruction &I : instructions(*Trial))
+        if (auto *CI = dyn_cast<CallInst>(&I))
+            Recurses |= CI->getCalledFunction() == Trial;
+
+    // Drop the analyses the pipeline cached for it before the body goes, so
+    // the real definition doesn't pick them up.
+    S.TheFAM->clear(*Trial, Trial->getName());
+    Trial->deleteBody();
+    if (Trial->use_empty())
+        Trial->eraseFromParent();
+    return Recurses;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Top-Level parsing and JIT Driver
+//===----------------------------------------------------------------------===//
+
+static void InitializeModuleAndManager(Session &S) {
+    S.TheContext = std::make_unique<LLVMContext>();
+    S.TheModule = std::make_unique<Module>("KaleidoscopeJIT", *S.TheContext);
+    S.TheModule -> setDataLayout(S.JIT.getDataLayout());
+
+    S.Builder = std::make_unique<IRBuilder<>>(*S.TheContext);
+
+    if (S.Opts.ProfileUse && S.Opts.ProfileUse->Summary)
+        S.TheModule -> setProfileSummary(
+            S.Opts.ProfileUse->Summary -> getMD(*S.TheContext),
+            ProfileSummary::PSK_Instr);
+
+    // Create new pass and analysis manager. Drop the old ones outer-first:
+    // a module-level proxy left over from -ipo still points into TheFAM.
+    S.TheMAM.reset();
+    S.TheCGAM.reset();
+    S.TheFAM.reset();
+    S.TheLAM.reset();
+    S.TheFPM = std::make_unique<FunctionPassManager>();
+    S.TheLAM = std::make_unique<LoopAnalysisManager>();
+    S.TheFAM = std::make_unique<FunctionAnalysisManager>();
+    S.TheCGAM = std::make_unique<CGSCCAnalysisManager>();
+    S.TheMAM = std::make_unique<ModuleAnalysisManager>();
+    S.ThePIC = std::make_unique<PassInstrumentationCallbacks>();
+    S.TheSI = std::make_unique<StandardInstrumentations>(/*DebugLogging*/ false);
+    S.TheSI->registerCallbacks(*S.ThePIC, S.TheFAM.get());
+
+    // Add transform passes.
+    // Do simple "peephole" optimizations and bit-twiddling optzns.
+    S.TheFPM->addPass(InstCombinePass());
+    // Reassociate expressions.
+    S.TheFPM->addPass(ReassociatePass());
+    // Eliminate Common SubExpressions.
+    S.TheFPM->addPass(GVNPass());
+    // Simplify the control flow graph (deleting unreachable blocks, etc).
+    S.TheFPM->addPass(SimplifyCFGPass());
+    // Turn self-recursive tail calls into loops.
+    S.TheFPM->addPass(TailCallElimPass());
+
+    // Register analysis passes used in these transform passes.
+    PassBuilder PB(nullptr, PipelineTuningOptions(), None, S.ThePIC.get());
+    PB.registerModuleAnalyses(*S.TheMAM);
+    PB.registerCGSCCAnalyses(*S.TheCGAM);
+    PB.registerFunctionAnalyses(*S.TheFAM);
+    PB.registerLoopAnalyses(*S.TheLAM);
+    PB.crossRegisterProxies(*S.TheLAM, *S.TheFAM, *S.TheCGAM, *S.TheMAM);
+}
+
+/// AddModuleToJIT - Hand the current module to the JIT and start a fresh one.
+/// The module (and its context) is owned by RT, or by the session's default
+/// tracker if RT is null.
+static void AddModuleToJIT(Session &S, ResourceTrackerSP RT = nullptr) {
+    if (!RT)
+        RT = S.JD.getDefaultResourceTracker();
+    ExitOnErr(S.JIT.addModule(
+        ThreadSafeModule(std::move(S.TheModule), std::move(S.TheContext)),
+        std::move(RT)));
+    InitializeModuleAndManager(S);
+}
+
+static std::atomic<unsigned> SessionCount{0};
+
+Session::Session(std::istream &In, KaleidoscopeJIT &JIT,
+                 const SessionOptions &Opts)
+    : Opts(Opts), In(In), JIT(JIT),
+      JD(ExitOnErr(JIT.createSessionDylib(
+          "session." + std::to_string(SessionCount++)))) {
+    InitializeModuleAndManager(*this);
+}
+
+Session::~Session() {
+    ExitOnErr(JIT.removeDylib(JD));
+}
+
+void SessionDeleter::operator()(Session *S) const { delete S; }
+
+SessionPtr createSession(std::istream &In, KaleidoscopeJIT &JIT,
+                         const SessionOptions &Opts) {
+    if (Opts.MemoizeSlots > MaxMemoizeSlots) {
+        fprintf(stderr, "MemoizeSlots must be at most %llu\n",
+                (unsigned long long)MaxMemoizeSlots);
+        return nullptr;
+    }
+    return SessionPtr(new Session(In, JIT, Opts));
+}
+
+
+//===----------------------------------------------------------------------===//
+// Module-level (interprocedural) optimization
+//===----------------------------------------------------------------------===//
+
+/// InlineRemarkCounter - Counts the inliner's "passed" remarks, i.e. call
+/// sites that were actually inlined.
+struct InlineRemarkCounter : public DiagnosticHandler {
+    unsigned NumInlined = 0;
+
+    bool isPassedOptRemarkEnabled(StringRef PassName) const override {
+        return PassName == "inline";
+    }
+
+    bool isAnyRemarkEnabled() const override { return true; }
+
+    bool handleDiagnostics(const DiagnosticInfo &DI) override {
+        if (DI.getKind() != DK_OptimizationRemark)
+            return false; // 나머지는 기본 출력
+        if (cast<OptimizationRemark>(DI).getPassName() == "inline")
+            ++NumInlined;
+        return true;
+    }
+};
+
+struct ModuleStats {
+    unsigned Functions = 0;
+    unsigned Instructions = 0;
+    unsigned Calls = 0; // direct calls to functions defined in the module
+};
+
+static ModuleStats collectStats(Module &M) {
+    ModuleStats S;
+    for (Function &F : M) {
+        if (F.isDeclaration())
+            continue;
+        ++S.Functions;
+        for (Instruction &I : instructions(F)) {
+            ++S.Instructions;
+            if (auto *CB = dyn_cast<CallBase>(&I))
+                if (Function *Callee = CB->getCalledFunction())
+                    if (!Callee->isDeclaration())
+                        ++S.Calls;
+        }
+    }
+    return S;
+}
+
+/// OptimizeModule - Run inliner, IPSCCP, function attribute inference and
+/// dead-function elimination over the batched module and report the effect.
+/// With KeepDefinitions, every def stays externally visible (object output);
+/// otherwise only the top-level expressions are entry points.
+static void OptimizeModule(Session &S, bool KeepDefinitions) {
+    ModuleStats Before = collectStats(*S.TheModule);
+
+    auto Counter = std::make_unique<InlineRemarkCounter>();
+    InlineRemarkCounter *Inlines = Counter.get();
+    S.TheContext->setDiagnosticHandler(std::move(Counter));
+
+    ModulePassManager MPM;
+    if (!KeepDefinitions)
+        MPM.addPass(InternalizePass([](const GlobalValue &GV) {
+            return GV.getName().startswith("__anon_expr");
+        }));
+    MPM.addPass(IPSCCPPass());
+
+    // 인라인 후 CGSCC 단위로 attribute 추론 + 정리
+    ModuleInlinerWrapperPass MIWP(getInlineParams(/*OptLevel*/ 2));
+    MIWP.getPM().addPass(PostOrderFunctionAttrsPass());
+    FunctionPassManager FPM;
+    FPM.addPass(InstCombinePass());
+    FPM.addPass(SimplifyCFGPass());
+    MIWP.getPM().addPass(createCGSCCToFunctionPassAdaptor(std::move(FPM)));
+    MPM.addPass(std::move(MIWP));
+
+    MPM.addPass(ReversePostOrderFunctionAttrsPass());
+    MPM.addPass(GlobalDCEPass());
+
+    MPM.run(*S.TheModule, *S.TheMAM);
+
+    ModuleStats After = collectStats(*S.TheModule);
+    if (S.Opts.Interactive)
+        fprintf(stderr,
+                "ipo: inlined %u call sites; calls %u -> %u, "
+                "functions %u -> %u, instructions %u -> %u\n",
+                Inlines->NumInlined, Before.Calls, After.Calls,
+                Before.Functions, After.Functions, Before.Instructions,
+                After.Instructions);
+
+    S.TheContext->setDiagnosticHandler(std::make_unique<DiagnosticHandler>());
+}
+
+/// EmitObjectFile - AOT path: compile the current module for the host.
+static bool EmitObjectFile(Session &S, const std::string &Filename) {
+    auto TargetTriple = sys::getDefaultTargetTriple();
+    std::string Error;
+    auto Target = TargetRegistry::lookupTarget(TargetTriple, Error);
+    if (!Target) {
+        errs() << Error;
+        return false;
+    }
+
+    TargetOptions Opt;
+    auto RM = Optional<Reloc::Model>(Reloc::PIC_);
+    std::unique_ptr<TargetMachine> TM(
+        Target->createTargetMachine(TargetTriple, "generic", "", Opt, RM));
+
+    S.TheModule->setDataLayout(TM->createDataLayout());
+    S.TheModule->setTargetTriple(TargetTriple);
+
+    std::error_code EC;
+    raw_fd_ostream Dest(Filename, EC, sys::fs::OF_None);
+    if (EC) {
+        errs() << "Could not open file: " << EC.message();
+        return false;
+    }
+
+    legacy::PassManager Pass;
+    if (TM->addPassesToEmitFile(Pass, Dest, nullptr, CGFT_ObjectFile)) {
+        errs() << "TheTargetMachine can't emit a file of this type";
+        return false;
+    }
+
+    Pass.run(*S.TheModule);
+    Dest.flush();
+    fprintf(stderr, "Wrote %s\n", Filename.c_str());
+    return true;
+}
+
+/// RunAnonExpr - Look up a JIT'd top-level expression, call it with the
+/// signature matching its inferred type and print the result.
+static void RunAnonExpr(Session &S, const std::string &Name, VarType RetType) {
+    JITEvaluatedSymbol ExprSymbol;
+    {
+        PhaseScope Timer(S, phase_jit_link);
+        ExprSymbol = ExitOnErr(S.JIT.lookup(S.JD, Name));
+    }
+    PhaseScope Timer(S, phase_exec);
+    switch (RetType) {
+      case type_int: {
+        auto *FP = (int64_t(*)())(intptr_t)ExprSymbol.getAddress();
+        long long V = FP();
+        if (S.Opts.Interactive)
+            fprintf(stderr, "Evaluated to %lld\n", V);
+        break;
+      }
+      case type_bool: {
+        auto *FP = (bool(*)())(intptr_t)ExprSymbol.getAddress();
+        bool V = FP();
+        if (S.Opts.Interactive)
+            fprintf(stderr, "Evaluated to %s\n", V ? "true" : "false");
+        break;
+      }
+      default: {
+        auto *FP = (double(*)())(intptr_t)ExprSymbol.getAddress();
+        double V = FP();
+        if (S.Opts.Interactive)
+            fprintf(stderr, "Evaluated to %f\n", V);
+        break;
+      }
+    }
+}
+
+/// FinishBatch - End of input in batch mode: optimize the single module, then
+/// either write it out or JIT it and run the pending top-level expressions.
+static void FinishBatch(Session &S) {
+    {
+        PhaseScope Timer(S, phase_optimize);
+        OptimizeModule(S, /*KeepDefinitions*/ !S.Opts.OutputFilename.empty());
+    }
+
+    if (!S.Opts.OutputFilename.empty()) {
+        PhaseScope Timer(S, phase_jit_link);
+        EmitObjectFile(S, S.Opts.OutputFilename);
+        return;
+    }
+
+    {
+        PhaseScope Timer(S, phase_jit_link);
+        AddModuleToJIT(S);
+    }
+    for (auto &E : S.PendingExprs)
+        RunAnonExpr(S, E.first, E.second);
+    S.PendingExprs.clear();
+}
+
+static void HandleDefinition(Session &S) {
+    if (auto FnAST = ParseDefinition(S)) {
+      if (auto *FnIR = FnAST->codegen(S)) {
+        if (S.Opts.Interactive) {
+            fprintf(stderr, "Read function definition:");
+            FnIR->print(errs());
+            fprintf(stderr, "\n");
+        }
+        if (!isBatchMode(S)) {
+            PhaseScope Timer(S, phase_jit_link);
+            AddModuleToJIT(S);
+        }
+        S.FunctionDefs[FnAST->getName()] = std::move(FnAST);
+      }
     } else {
       // Skip token for error recovery.
-      getNextToken();
+      getNextToken(S);
     }
 }
-  
-  static void HandleExtern() {
-    if (ParseExtern()) {
-      fprintf(stderr, "Parsed an extern\n");
+
+  static void HandleExtern(Session &S) {
+    if (auto ProtoAST = ParseExtern(S)) {
+      if (auto *FnIR = ProtoAST->codegen(S)) {
+        if (S.Opts.Interactive) {
+            fprintf(stderr, "Read extern: ");
+            FnIR->print(errs());
+            fprintf(stderr, "\n");
+        }
+        S.FunctionProtos[ProtoAST->getName()] = std::move(ProtoAST);
+      }
     } else {
       // Skip token for error recovery.
-      getNextToken();
+      getNextToken(S);
     }
 }
-  
-  static void HandleTopLevelExpression() {
+
+  static void HandleTopLevelExpression(Session &S) {
     // Evaluate a top-level expression into an anonymous function.
-    if (ParseTopLevelExpr()) {
-      fprintf(stderr, "Parsed a top-level expr\n");
+    if (auto FnAST = ParseTopLevelExpr(S)) {
+      if (auto *FnIR = FnAST->codegen(S)) {
+        std::string Name = std::string(FnIR->getName());
+        VarType RetType = getVarType(FnIR->getReturnType());
+
+        // batch 모드에서는 모듈 전체 최적화가 끝난 뒤에 실행
+        if (isBatchMode(S)) {
+            S.PendingExprs.push_back({Name, RetType});
+            return;
+        }
+
+        // 식마다 따로 tracker 를 두고, 실행이 끝나면 모듈/컨텍스트/코드를
+        // 모두 반납한다. def 는 기본 tracker 에 남아 있다.
+        auto RT = S.JD.createResourceTracker();
+        {
+            PhaseScope Timer(S, phase_jit_link);
+            AddModuleToJIT(S, RT);
+        }
+        RunAnonExpr(S, Name, RetType);
+
+        PhaseScope Timer(S, phase_jit_link);
+        ExitOnErr(RT->remove());
+        S.FunctionProtos.erase(Name);
+        S.JIT.releaseDeadSymbols();
+      } else {
+        // codegen 이 실패해도 prototype 은 이미 등록돼 있다.
+        S.FunctionProtos.erase(FnAST->getName());
+      }
     } else {
       // Skip token for error recovery.
-      getNextToken();
+      getNextToken(S);
     }
 }
-  
+
   /// top ::= definition | external | expression | ';'
-  static void MainLoop() {
+  static void MainLoop(Session &S) {
     while (true) {
-      fprintf(stderr, "ready> ");
-      switch (CurTok) {
+      if (S.Opts.Interactive)
+        fprintf(stderr, "ready> ");
+      switch (S.CurTok) {
       case tok_eof:
         return;
       case ';': // ignore top-level semicolons.
-        getNextToken();
+        getNextToken(S);
         break;
       case tok_def:
-        HandleDefinition();
+        HandleDefinition(S);
         break;
       case tok_extern:
-        HandleExtern();
+        HandleExtern(S);
         break;
       default:
-        HandleTopLevelExpression();
+        HandleTopLevelExpression(S);
         break;
       }
     }
 }
 
 
-static std::unique_ptr<LLVMContext> TheContext;
-static std::unique_ptr<IRBuilder<>> Builder;
-static std::unique_ptr<Module> TheModule;
-static std::map<std::string, Value *> NamedValues;
+/// reportPhaseTimes - One "phases key=value ..." line, for scripts (see
+/// bench/bench.py).
+static void reportPhaseTimes(Session &S) {
+    S.enterPhase(phase_none);
+    printf("phases parse_s=%.6f codegen_s=%.6f optimize_s=%.6f "
+           "jit_link_s=%.6f exec_s=%.6f defs=%zu exprs=%u\n",
+           S.PhaseSeconds[phase_parse], S.PhaseSeconds[phase_codegen],
+           S.PhaseSeconds[phase_optimize], S.PhaseSeconds[phase_jit_link],
+           S.PhaseSeconds[phase_exec], S.FunctionDefs.size(),
+           S.AnonExprCount);
+    fflush(stdout);
+}
+
+void RunSession(Session &S) {
+    if (S.Opts.Interactive)
+        fprintf(stderr, "ready> ");
+    getNextToken(S);
+
+    MainLoop(S);
+
+    if (isBatchMode(S))
+        FinishBatch(S);
+
+    if (S.Opts.Memoize && S.Opts.Interactive)
+        reportMemoStats(S);
+    if (S.Opts.TimePhases && S.Opts.Interactive)
+        reportPhaseTimes(S);
+}
+
+
+//===----------------------------------------------------------------------===//
+// Vectorized batch calls
+//===----------------------------------------------------------------------===//
+
+/// emitPrivateCopies - Emit Name and every def it reaches into the current
+/// module with internal linkage, so the optimizer sees their bodies.
+static Function *emitPrivateCopies(Session &S, const std::string &Name) {
+    std::vector<Function *> Copies;
+    std::vector<std::string> Worklist{Name};
+    S.EmittingCopy = true;
+    while (!Worklist.empty()) {
+        for (auto &N : Worklist) {
+            auto *F = S.FunctionDefs[N]->codegen(S);
+            if (!F) {
+                S.EmittingCopy = false;
+                return nullptr;
+            }
+            Copies.push_back(F);
+        }
+        // 새로 생긴 선언 중 def 가 있는 것들을 다음 차례로
+        Worklist.clear();
+        for (Function &F : *S.TheModule)
+            if (F.isDeclaration() && S.FunctionDefs.count(F.getName().str()))
+                Worklist.push_back(F.getName().str());
+    }
+    S.EmittingCopy = false;
+
+    for (auto *F : Copies)
+        F->setLinkage(Function::InternalLinkage);
+    return Copies.front();
+}
+
+/// emitBatchLoop - Build the BatchCallFn wrapper around Callee.
+static Function *emitBatchLoop(Session &S, Function *Callee) {
+    LLVMContext &Ctx = *S.TheContext;
+    Type *PtrTy = Type::getInt8PtrTy(Ctx);
+    Type *I64 = Type::getInt64Ty(Ctx);
+    Type *RetTy = Callee->getReturnType();
+
+    FunctionType *FT = FunctionType::get(
+        Type::getVoidTy(Ctx), {PtrTy->getPointerTo(), PtrTy, I64, I64}, false);
+    Function *W = Function::Create(FT, Function::ExternalLinkage,
+                                   "__batch." + Callee->getName(),
+                                   S.TheModule.get());
+    auto AI = W->arg_begin();
+    Value *Args = AI++, *Out = AI++, *Begin = AI++, *End = AI;
+    W->addParamAttr(1, Attribute::NoAlias);
+
+    BasicBlock *Entry = BasicBlock::Create(Ctx, "entry", W);
+    BasicBlock *Loop = BasicBlock::Create(Ctx, "loop", W);
+    BasicBlock *Exit = BasicBlock::Create(Ctx, "exit", W);
+
+    S.Builder->SetInsertPoint(Entry);
+    std::vector<Value *> Columns;
+    for (auto &Arg : Callee->args()) {
+        Value *Col = S.Builder->CreateLoad(
+            PtrTy, S.Builder->CreateConstInBoundsGEP1_64(PtrTy, Args,
+                                                         Arg.getArgNo()));
+        Columns.push_back(
+            S.Builder->CreateBitCast(Col, Arg.getType()->getPointerTo()));
+    }
+    Value *OutCol = S.Builder->CreateBitCast(Out, RetTy->getPointerTo());
+    S.Builder->CreateCondBr(S.Builder->CreateICmpSLT(Begin, End), Loop, Exit);
+
+    S.Builder->SetInsertPoint(Loop);
+    PHINode *I = S.Builder->CreatePHI(I64, 2, "i");
+    std::vector<Value *> CallArgs;
+    for (auto &Arg : Callee->args())
+        CallArgs.push_back(S.Builder->CreateLoad(
+            Arg.getType(),
+            S.Builder->CreateInBoundsGEP(Arg.getType(),
+                                         Columns[Arg.getArgNo()], I)));
+    Value *R = S.Builder->CreateCall(Callee, CallArgs);
+    S.Builder->CreateStore(R, S.Builder->CreateInBoundsGEP(RetTy, OutCol, I));
+    Value *Next = S.Builder->CreateAdd(I, ConstantInt::get(I64, 1), "i.next",
+                                      /*HasNUW*/ true, /*HasNSW*/ true);
+    S.Builder->CreateCondBr(S.Builder->CreateICmpSLT(Next, End), Loop, Exit);
+    I->addIncoming(Begin, Entry);
+    I->addIncoming(Next, Loop);
+
+    S.Builder->SetInsertPoint(Exit);
+    S.Builder->CreateRetVoid();
+
+    verifyFunction(*W);
+    return W;
+}
+
+/// optimizeBatchModule - The O3 pipeline, with the host's TargetMachine so
+/// the inliner and the loop/SLP vectorizers get real cost models.
+static void optimizeBatchModule(Session &S) {
+    auto JTMB = ExitOnErr(JITTargetMachineBuilder::detectHost());
+    auto TM = ExitOnErr(JTMB.createTargetMachine());
+    S.TheModule->setTargetTriple(TM->getTargetTriple().str());
+
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+
+    PipelineTuningOptions PTO;
+    PTO.LoopVectorization = true;
+    PTO.SLPVectorization = true;
+    PassBuilder PB(TM.get(), PTO);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    PB.buildPerModuleDefaultPipeline(OptimizationLevel::O3)
+        .run(*S.TheModule, MAM);
+}
+
+bool getDefSignature(Session &S, const std::string &Name,
+                     std::vector<VarType> &ArgTypes, VarType &RetType) {
+    auto PI = S.FunctionProtos.find(Name);
+    if (PI == S.FunctionProtos.end() || !S.FunctionDefs.count(Name))
+        return false;
+    PrototypeAST &P = *PI->second;
+    ArgTypes.clear();
+    for (unsigned i = 0; i != P.getArgs().size(); ++i)
+        ArgTypes.push_back(P.getArgType(i));
+    RetType = P.getRetType();
+    return true;
+}
+
+uint64_t lookupDef(Session &S, const std::string &Name) {
+    if (!S.FunctionDefs.count(Name))
+        return 0;
+    auto Sym = S.JIT.lookup(S.JD, Name);
+    if (!Sym) {
+        consumeError(Sym.takeError());
+        return 0;
+    }
+    return Sym->getAddress();
+}
+
+BatchCallFn compileBatchCall(Session &S, const std::string &Name) {
+    auto BI = S.BatchCalls.find(Name);
+    if (BI != S.BatchCalls.end())
+        return BI->second;
+
+    if (!S.FunctionDefs.count(Name)) {
+        LogErrorV("Unknown function referenced in batch call");
+        return nullptr;
+    }
 
-int main() {
-    fprintf(stderr, "ready> ");
-    getNextToken();
+    Function *Callee = emitPrivateCopies(S, Name);
+    if (!Callee)
+        return nullptr;
+    std::string WrapperName = emitBatchLoop(S, Callee)->getName().str();
+    optimizeBatchModule(S);
+    AddModuleToJIT(S);
+
+    auto Sym = ExitOnErr(S.JIT.lookup(S.JD, WrapperName));
+    auto Fn = (BatchCallFn)(intptr_t)Sym.getAddress();
+    S.BatchCalls[Name] = Fn;
+    return Fn;
+}
 
-    MainLoop();
+void runBatchCall(BatchCallFn Fn, void *const *Args, void *Out, int64_t N,
+                  unsigned Threads) {
+    if (Threads <= 1) {
+        Fn(Args, Out, 0, N);
+        return;
+    }
+    std::vector<std::thread> Workers;
+    for (unsigned T = 0; T != Threads; ++T)
+        Workers.emplace_back(Fn, Args, Out, N * T / Threads,
+                             N * (T + 1) / Threads);
+    for (auto &W : Workers)
+        W.join();
+}
+
+
+//===----------------------------------------------------------------------===//
+// "Library" functions that can be "extern'd" from user code.
+//===----------------------------------------------------------------------===//
+
+/// putchard - putchar that takes a double and returns 0.
+extern "C" double putchard(double X) {
+    fputc((char)X, stderr);
+    return 0;
+}
+
+/// printd - printf that takes a double prints it as "%f\n", returning 0.
+extern "C" double printd(double X) {
+    fprintf(stderr, "%f\n", X);
     return 0;
 }
 
+/// printi - printf for int values, returning 0.
+extern "C" int64_t printi(int64_t X) {
+    fprintf(stderr, "%lld\n", (long long)X);
+    return 0;
+}
+
+
+#ifndef MYLANG_NO_MAIN
+
+//===----------------------------------------------------------------------===//
+// Command line (the my-lang driver)
+//===----------------------------------------------------------------------===//
+
+// Everything from here on is the driver only. The mylang library registers
+// no options; these map onto SessionOptions.
+
+static std::unique_ptr<KaleidoscopeJIT> TheJIT;
+
+static cl::opt<bool> IPOMode(
+    "ipo",
+    cl::desc("Batch every definition into one module and run the "
+             "interprocedural pipeline before JIT/object emission"));
+
+static cl::opt<std::string> OutputFilename(
+    "o", cl::desc("Write the batched module to an object file (implies -ipo)"),
+    cl::value_desc("filename"));
+
+static cl::opt<std::string> ProfileGenerate(
+    "profile-generate",
+    cl::desc("Instrument JIT'd code with entry/branch counters and write "
+             "them to <file> at exit"),
+    cl::value_desc("file"));
+
+static cl::opt<std::string> ProfileUse(
+    "profile-use",
+    cl::desc("Attach entry counts and branch weights from <file>"),
+    cl::value_desc("file"));
+
+static cl::opt<bool> ReportTailCalls(
+    "report-tail-calls",
+    cl::desc("Report self-recursive calls left after tail-call elimination"));
+
+static cl::opt<bool> MemoizePure(
+    "memoize",
+    cl::desc("Cache the results of pure defs (no externs reachable) in a "
+             "fixed-size table keyed on the argument bits"));
+
+static cl::opt<unsigned> MemoizeSlots(
+    "memoize-slots",
+    cl::desc("Entries per memoized def, rounded up to a power of two "
+             "(at most 2^24)"),
+    cl::init(4096));
+
+static cl::opt<bool> TimePhases(
+    "time-phases",
+    cl::desc("At end of input, print the wall time spent parsing, in codegen, "
+             "optimizing, in JIT linking and executing, as one line on "
+             "stdout"));
+
+/// DriverOptions - SessionOptions from the flags above; main() fills in
+/// ProfileUse. The benchmarks run their sessions with Interactive off.
+static SessionOptions DriverOptions;
+
+static void setDriverOptions() {
+    DriverOptions.IPO = IPOMode;
+    DriverOptions.OutputFilename = OutputFilename;
+    DriverOptions.ProfileGenerate = !ProfileGenerate.empty();
+    DriverOptions.ReportTailCalls = ReportTailCalls;
+    DriverOptions.Memoize = MemoizePure;
+    DriverOptions.MemoizeSlots = MemoizeSlots;
+    DriverOptions.TimePhases = TimePhases;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Multi-session benchmark
+//===----------------------------------------------------------------------===//
+
+static cl::opt<unsigned> BenchSessions(
+    "bench-sessions",
+    cl::desc("Run the program on stdin in independent sessions on 1, 2, 4 "
+             ".. N threads and print sessions/s for each"),
+    cl::value_desc("N"), cl::init(0));
+
+static cl::opt<unsigned> BenchRounds(
+    "bench-rounds", cl::desc("Sessions per thread for -bench-sessions"),
+    cl::init(20));
+
+static void RunSessionBenchmark(const std::string &Source) {
+    for (unsigned Threads = 1;; Threads *= 2) {
+        Threads = std::min(Threads, (unsigned)BenchSessions);
+
+        auto Start = std::chrono::steady_clock::now();
+        std::vector<std::thread> Workers;
+        for (unsigned T = 0; T != Threads; ++T)
+            Workers.emplace_back([&Source] {
+                for (unsigned R = 0; R != BenchRounds; ++R) {
+                    std::istringstream In(Source);
+                    SessionOptions Opts = DriverOptions;
+                    Opts.Interactive = false;
+                    Session S(In, *TheJIT, Opts);
+                    RunSession(S);
+                }
+            });
+        for (auto &W : Workers)
+            W.join();
+        double Secs = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - Start).count();
+
+        unsigned Sessions = Threads * BenchRounds;
+        printf("sessions threads=%u sessions=%u seconds=%.3f "
+               "sessions_per_sec=%.1f\n",
+               Threads, Sessions, Secs, Sessions / Secs);
+        fflush(stdout);
+
+        if (Threads == BenchSessions)
+            break;
+    }
+}
+
 
+//===----------------------------------------------------------------------===//
+// REPL soak test
+//===----------------------------------------------------------------------===//
+
+static cl::opt<unsigned> SoakExprs(
+    "soak",
+    cl::desc("Evaluate N generated top-level expressions in one session and "
+             "print the resident set size as it goes"),
+    cl::value_desc("N"), cl::init(0));
+
+static cl::opt<bool> SoakErrors(
+    "soak-errors",
+    cl::desc("With -soak, make every other expression fail in codegen "
+             "(unknown variable)"));
+
+/// residentBytes - Current RSS of this process, from /proc/self/statm.
+static size_t residentBytes() {
+    size_t Pages = 0, Resident = 0;
+    if (FILE *F = fopen("/proc/self/statm", "r")) {
+        if (fscanf(F, "%zu %zu", &Pages, &Resident) != 2)
+            Resident = 0;
+        fclose(F);
+    }
+    return Resident * sysconf(_SC_PAGESIZE);
+}
 
-void InitializeModuleAndManager(void) {
-    TheContext = std::make_unique<LLVMCOntext>();
-    TheModule = std::make_unique<Module>("KaleidoscopeJIT", *TheContext);
-    TheModule -> setDataLayout(TheJIT -> getDataLayout());
+/// SoakSource - Streams one def followed by SoakExprs expressions calling it,
+/// generated on demand so the input itself takes no memory. Prints RSS ten
+/// times over the run. With -soak-errors every odd expression parses but
+/// fails codegen, which must not leak either.
+class SoakSource : public std::streambuf {
+    std::string Buf = "def soak(x:int) : int x * 3 + 1;\n";
+    unsigned Emitted = 0;
+
+protected:
+    int underflow() override {
+        if (Emitted == SoakExprs)
+            return traits_type::eof();
+        unsigned Step = std::max(1u, (unsigned)SoakExprs / 10);
+        if (Emitted % Step == 0) {
+            printf("soak exprs=%u rss_kb=%zu\n", Emitted,
+                   residentBytes() / 1024);
+            fflush(stdout);
+        }
+        bool Fail = SoakErrors && Emitted % 2;
+        Buf = "soak(" + std::to_string(Emitted++) + ")" +
+              (Fail ? " + nosuch;\n" : ";\n");
+        setg(&Buf[0], &Buf[0], &Buf[0] + Buf.size());
+        return traits_type::to_int_type(Buf[0]);
+    }
 
-    Builder = std::make_unique<IRBuilder<>>(*TheContext);
+public:
+    SoakSource() { setg(&Buf[0], &Buf[0], &Buf[0] + Buf.size()); }
+};
 
-    // Create new pass and analysis manager.
-    TheFPM = std::make_unique<FunctionPassManager>();
-    TheLAM = std::make_unique<LoopAnalysisManager>();
-    TheFAM = std::make_unique<FunctionAnalysisManager>();
-    TheCGAM = std::make_unique<CGSCCAnalysisManager>();
-    TheMAM = std::make_unique<ModuleAnalysisManager>();
-    ThePIC = std::make_unique<PassInstrumentationCallbacks>();
-    TheSI = std::make_unique<StandardInstrumentations>(*TheContext,
-                                                    /*DebugLogging*/ true);
-    TheSI->registerCallbacks(*ThePIC, TheMAM.get());
+static void RunSoakTest() {
+    SoakSource Source;
+    std::istream In(&Source);
+    SessionOptions Opts = DriverOptions;
+    Opts.Interactive = false;
+    Session S(In, *TheJIT, Opts);
+    RunSession(S);
+    printf("soak exprs=%u rss_kb=%zu\n", (unsigned)SoakExprs,
+           residentBytes() / 1024);
 }
 
 
+//===----------------------------------------------------------------------===//
+// Batch-call benchmark
+//===----------------------------------------------------------------------===//
+
+static cl::opt<std::string> BenchBatch(
+    "bench-batch",
+    cl::desc("After running the program on stdin, time def NAME (double "
+             "arguments only) over arrays: per-element calls vs batch calls "
+             "on 1, 2, 4 .. -batch-threads threads"),
+    cl::value_desc("NAME"));
+
+static cl::opt<unsigned> BatchElements(
+    "batch-elements", cl::desc("Array length for -bench-batch"),
+    cl::init(10000000));
+
+static cl::opt<unsigned> BatchThreads(
+    "batch-threads", cl::desc("Most threads to use for -bench-batch"),
+    cl::init(std::max(1u, std::thread::hardware_concurrency())));
+
+/// callPerElement - The baseline: one call through a function pointer per
+/// element.
+static bool callPerElement(uint64_t Addr, unsigned Arity,
+                           const std::vector<std::vector<double>> &Cols,
+                           std::vector<double> &Out) {
+    size_t N = Out.size();
+    switch (Arity) {
+      case 1: {
+        auto *FP = (double(*)(double))(intptr_t)Addr;
+        for (size_t I = 0; I != N; ++I)
+            Out[I] = FP(Cols[0][I]);
+        return true;
+      }
+      case 2: {
+        auto *FP = (double(*)(double, double))(intptr_t)Addr;
+        for (size_t I = 0; I != N; ++I)
+            Out[I] = FP(Cols[0][I], Cols[1][I]);
+        return true;
+      }
+      case 3: {
+        auto *FP = (double(*)(double, double, double))(intptr_t)Addr;
+        for (size_t I = 0; I != N; ++I)
+            Out[I] = FP(Cols[0][I], Cols[1][I], Cols[2][I]);
+        return true;
+      }
+      default:
+        return false;
+    }
+}
+
+static void printBatchResult(const char *Mode, unsigned Threads, size_t N,
+                             double Secs) {
+    printf("batch mode=%s threads=%u elements=%zu seconds=%.3f "
+           "elements_per_sec=%.1f\n",
+           Mode, Threads, N, Secs, N / Secs);
+    fflush(stdout);
+}
+
+/// RunBatchBenchmark - Drives the session only through MyLang.h, as a host
+/// program would.
+static bool RunBatchBenchmark(std::istream &Source) {
+    // -ipo internalizes every def, leaving nothing to call per element.
+    if (DriverOptions.IPO || !DriverOptions.OutputFilename.empty()) {
+        fprintf(stderr,
+                "-bench-batch needs separately JIT'd defs; drop -ipo/-o\n");
+        return false;
+    }
+
+    SessionOptions Opts = DriverOptions;
+    Opts.Interactive = false;
+    SessionPtr SP = createSession(Source, *TheJIT, Opts);
+    if (!SP)
+        return false;
+    Session &S = *SP;
+    RunSession(S);
+
+    std::vector<VarType> ArgTypes;
+    VarType RetType;
+    if (!getDefSignature(S, BenchBatch, ArgTypes, RetType)) {
+        fprintf(stderr, "-bench-batch: no def named %s\n", BenchBatch.c_str());
+        return false;
+    }
+    unsigned Arity = ArgTypes.size();
+    bool AllDouble = RetType == type_double;
+    for (VarType T : ArgTypes)
+        AllDouble &= T == type_double;
+    if (!AllDouble || Arity < 1 || Arity > 3) {
+        fprintf(stderr, "-bench-batch: %s must take 1-3 doubles and return "
+                        "double\n", BenchBatch.c_str());
+        return false;
+    }
+
+    size_t N = BatchElements;
+    std::vector<std::vector<double>> Cols(Arity, std::vector<double>(N));
+    std::vector<void *> Args;
+    for (unsigned k = 0; k != Arity; ++k) {
+        for (size_t I = 0; I != N; ++I)
+            Cols[k][I] = (I % 1024) * 0.25 + k + 1;
+        Args.push_back(Cols[k].data());
+    }
+    std::vector<double> Expected(N), Out(N);
+
+    uint64_t Addr = lookupDef(S, BenchBatch);
+    auto Start = std::chrono::steady_clock::now();
+    callPerElement(Addr, Arity, Cols, Expected);
+    printBatchResult("per-element", 1, N,
+                     std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - Start).count());
+
+    BatchCallFn Fn = compileBatchCall(S, BenchBatch);
+    if (!Fn)
+        return false;
+    for (unsigned Threads = 1;; Threads *= 2) {
+        Threads = std::min(Threads, (unsigned)BatchThreads);
+        std::fill(Out.begin(), Out.end(), 0.0);
+
+        Start = std::chrono::steady_clock::now();
+        runBatchCall(Fn, Args.data(), Out.data(), N, Threads);
+        printBatchResult("batch", Threads, N,
+                         std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - Start).count());
+
+        if (Out != Expected) {
+            fprintf(stderr, "-bench-batch: results differ from per-element "
+                            "calls\n");
+            return false;
+        }
+        if (Threads == BatchThreads)
+            break;
+    }
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    cl::ParseCommandLineOptions(argc, argv, "my-lang JIT\n");
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+
+    if (!ProfileGenerate.empty() && !OutputFilename.empty()) {
+        fprintf(stderr, "-profile-generate needs the JIT; drop -o\n");
+        return 1;
+    }
+    if (MemoizeSlots > MaxMemoizeSlots) {
+        fprintf(stderr, "-memoize-slots must be at most %llu\n",
+                (unsigned long long)MaxMemoizeSlots);
+        return 1;
+    }
+    // 프로파일은 stdin 의 REPL 세션 하나에서만 기록된다.
+    if (!ProfileGenerate.empty() &&
+        (BenchSessions || SoakExprs || !BenchBatch.empty())) {
+        fprintf(stderr, "-profile-generate records the session on stdin; "
+                        "drop -bench-sessions/-soak/-bench-batch\n");
+        return 1;
+    }
+    setDriverOptions();
+    if (!ProfileUse.empty() &&
+        !(DriverOptions.ProfileUse = readProfile(ProfileUse)))
+        return 1;
+
+    TheJIT = ExitOnErr(KaleidoscopeJIT::Create());
+
+    if (BenchSessions) {
+        std::stringstream Source;
+        Source << std::cin.rdbuf();
+        RunSessionBenchmark(Source.str());
+        return 0;
+    }
+    if (SoakExprs) {
+        RunSoakTest();
+        return 0;
+    }
+    if (!BenchBatch.empty())
+        return RunBatchBenchmark(std::cin) ? 0 : 1;
+
+    Session S(std::cin, *TheJIT, DriverOptions);
+    RunSession(S);
+
+    if (!ProfileGenerate.empty() && !writeProfile(S, ProfileGenerate))
+        return 1;
+    return 0;
+}
+#endif // MYLANG_NO_MAIN